@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "vole/datamodel.hpp"
+
+namespace vole::datamodel {
+
+    /**
+     * An array which stores its elements column-wise when they all are
+     * objects with the same literal members, such as a list of records.
+     *
+     * Instead of one object_node per element, each with its own children
+     * and names, a compacted array keeps one shape listing the member
+     * names and one column of values per member. Numbers and strings are
+     * kept in plain vectors, so scanning one member over all elements reads
+     * contiguous memory. Parsers hand each element over as soon as it is
+     * complete, so at most one element of a uniform array exists as nodes
+     * while it is parsed.
+     *
+     * The regular array API still works: the element objects are built
+     * from the columns the first time the children are accessed, after
+     * which the columns are released for good. Any get_children() call does
+     * this, such as an index lookup like `list[2]` which does not end in a
+     * member; the array then costs as much as a regular one. Reading single
+     * members through get_column(), hashing, comparing and reading the
+     * elements one by one through element() work on the columns instead.
+     * The latter is how descenders, including dumps, diffs and parallel
+     * traversals, walk a columnar array.
+     */
+    class columnar_array_node : public array_node {
+    public:
+        using column = std::variant<
+            std::vector<num_type>,
+            std::vector<string_type>,
+            // Columns mixing types, or holding booleans, nulls or binaries
+            std::vector<literal_value>
+        >;
+
+        explicit columnar_array_node(node_name name);
+        ~columnar_array_node() override;
+
+        /**
+         * Move the last element into the columns being built, if it and
+         * every element before it are objects with the same literal members
+         * in the same order. Otherwise the array keeps its elements as nodes
+         * from now on. Called by parsers whenever an element is complete.
+         * @return true if the element was moved into the columns
+         * @throws invalid_operation_exception if the array is frozen
+         */
+        bool absorb_last();
+
+        /**
+         * Move the remaining elements into columns, if they are objects which
+         * all have the same literal members in the same order as the ones
+         * taken by absorb_last(). Does nothing otherwise.
+         * @param min_elements Arrays with fewer elements are left as they are
+         * @return true if the array is columnar afterwards
+         * @throws invalid_operation_exception if the array is frozen
+         */
+        bool compact(size_t min_elements = 2);
+
+        [[nodiscard]] bool is_columnar() const {
+            return shape != nullptr;
+        }
+
+        /**
+         * @return true if the element objects currently exist as nodes
+         */
+        [[nodiscard]] bool is_materialized() const {
+            return !is_columnar() || materialized.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @return The member names every element has, empty unless columnar
+         */
+        [[nodiscard]] const std::vector<node_name> &get_shape() const;
+
+        /**
+         * @return The number of elements, without materializing them
+         */
+        [[nodiscard]] size_t size() const override;
+
+        /**
+         * Build one element from the columns, unless the array is
+         * materialized. The element is not kept by the array.
+         */
+        [[nodiscard]] shared_node element(size_t index) const override;
+
+        /**
+         * @return The values of one member for all elements, or nullptr if
+         *         the array is not columnar, is materialized or has no such
+         *         member. The values stay valid while the pointer is held,
+         *         even if the array is materialized meanwhile.
+         */
+        [[nodiscard]] std::shared_ptr<const column> get_column(std::string_view key) const;
+
+        /**
+         * Create an array with another name holding the same elements. The
+         * columns of a columnar array are shared with the copy, and its
+         * elements are named after the copy once materialized. The elements
+         * of an array which is not columnar are shared as they are.
+         */
+        [[nodiscard]] std::shared_ptr<columnar_array_node> copy_as(node_name name) const;
+
+        /**
+         * Two columnar arrays which are not materialized compare their
+         * columns, anything else compares the elements.
+         */
+        bool operator==(const node &other) const override;
+
+        void freeze() override;
+
+    protected:
+        void materialize() const override;
+
+        /**
+         * Hash the elements of a columnar array from the columns. The hash
+         * is the one the materialized elements would have.
+         */
+        [[nodiscard]] std::uint64_t compute_hash() const override;
+
+    private:
+        // The columns while they are filled by absorb_last() and compact()
+        struct column_builder;
+
+        bool absorb(const node &element);
+        // Turn the columns being built back into element nodes, and stop building them
+        void keep_rows();
+
+        std::shared_ptr<const std::vector<node_name>> shape;
+        // Released once the elements are materialized
+        mutable std::atomic<std::shared_ptr<const std::vector<column>>> columns;
+        size_t element_count = 0;
+        std::unique_ptr<column_builder> pending;
+        bool rows_only = false;
+        mutable std::once_flag once;
+        mutable std::atomic<bool> materialized = false;
+    };
+
+}
@@ -1,10 +1,15 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 namespace vole::datamodel {
@@ -16,19 +21,102 @@ namespace vole::datamodel {
     using string_type = std::string;
     using bool_type = bool;
     using null_type = nullptr_t;
+    using binary_type = std::vector<std::uint8_t>;
+
+    /**
+     * An immutable, shared node name.
+     *
+     * Names handed out by the same name_pool share their storage, so two
+     * names of one pool compare by pointer alone. Other names keep short
+     * texts inline, without allocating, and share longer ones on copy.
+     * They, and names of different pools, fall back to comparing the text.
+     */
+    class node_name {
+        friend class name_pool;
+    public:
+        node_name(std::string text);
+        node_name(const char *text);
+
+        [[nodiscard]] std::string_view view() const {
+            if (const auto pooled = std::get_if<pooled_text>(&storage)) {
+                return *pooled->text;
+            }
+            if (const auto shared = std::get_if<shared_text>(&storage)) {
+                return **shared;
+            }
+            const auto &short_name = std::get<inline_text>(storage);
+            return {short_name.chars.data(), short_name.size};
+        }
+
+        bool operator==(const node_name &other) const {
+            const auto pooled = std::get_if<pooled_text>(&storage);
+            const auto other_pooled = std::get_if<pooled_text>(&other.storage);
+            if (pooled != nullptr && other_pooled != nullptr && pooled->table == other_pooled->table) {
+                // A pool stores every text once, so another pointer is another text
+                return pooled->text == other_pooled->text;
+            }
+            return view() == other.view();
+        }
+
+    private:
+        struct name_table;
+
+        // Enough for element names such as `items[123]`
+        static constexpr size_t inline_capacity = 15;
+        struct inline_text {
+            std::array<char, inline_capacity> chars;
+            std::uint8_t size;
+        };
+        using shared_text = std::shared_ptr<const std::string>;
+        struct pooled_text {
+            // Keeps the text alive, and identifies the pool
+            std::shared_ptr<const name_table> table;
+            const std::string *text;
+        };
+
+        explicit node_name(pooled_text text)
+            : storage(std::move(text)) {}
+
+        std::variant<inline_text, shared_text, pooled_text> storage;
+    };
+
+    /**
+     * The name_pool interns node names so that documents which repeat the
+     * same member names store each of them only once. Interned names stay
+     * valid after the pool is destroyed. A name_pool is thread-safe.
+     */
+    class name_pool {
+    public:
+        name_pool();
+
+        [[nodiscard]] node_name intern(std::string_view text);
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        std::shared_ptr<node_name::name_table> table;
+    };
 
     /**
      * Abstract entity class to represent internal data nodes
+     *
+     * Nodes are not internally synchronized. Concurrent readers are only
+     * safe once the tree has been frozen (see node::freeze and
+     * frozen_document), after which every mutation is rejected.
      */
     class node {
     public:
         using shared_node = std::shared_ptr<node>;
         using node_list = std::vector<shared_node>;
-        explicit node(std::string name) : _name(std::move(name)) {}
+        explicit node(node_name name) : _name(std::move(name)) {}
         virtual ~node() = default;
         [[nodiscard]] virtual std::string type() const = 0;
 
         [[nodiscard]] std::string_view name() const {
+            return _name.view();
+        }
+
+        [[nodiscard]] const node_name& name_handle() const {
             return _name;
         }
 
@@ -40,8 +128,57 @@ namespace vole::datamodel {
         virtual bool operator==(const node &) const = 0;
         virtual bool operator!=(const node &) const;
 
+        /**
+         * Freeze this node and all of its descendants. Once frozen, any
+         * attempt to modify the node throws an invalid_operation_exception.
+         */
+        virtual void freeze();
+
+        [[nodiscard]] bool is_frozen() const {
+            return frozen;
+        }
+
+        /**
+         * A hash of the type, name and content of this node and its entire
+         * subtree. Equal subtrees hash equally. The hash is keyed with a
+         * random key per process, so it must not be stored or compared
+         * across processes, and unequal subtrees collide with a chance of
+         * about 2^-64. Frozen nodes compute their hash only once and keep
+         * it, mutable nodes recompute it every time.
+         */
+        [[nodiscard]] std::uint64_t subtree_hash() const;
+
+    protected:
+        /**
+         * Throw an invalid_operation_exception if the node has been frozen.
+         * Must be called by every mutating member function.
+         */
+        void check_mutable() const;
+
+        /**
+         * Hash this node, combining the subtree_hash() of its children
+         */
+        [[nodiscard]] virtual std::uint64_t compute_hash() const = 0;
+
+        /**
+         * Fold a value into a running hash
+         */
+        [[nodiscard]] static std::uint64_t combine_hash(std::uint64_t seed, std::uint64_t value);
+
+        /**
+         * @return The subtree_hash() of a node with this name and compute_hash() result
+         */
+        [[nodiscard]] static std::uint64_t named_hash(std::string_view name, std::uint64_t content);
+
+        // What array and object nodes start combining the hashes of their children with
+        static constexpr std::uint64_t array_hash_seed = 0xa11a7;
+        static constexpr std::uint64_t object_hash_seed = 0x0b1ec7;
+
     private:
-        std::string _name;
+        node_name _name;
+        bool frozen = false;
+        // Zero until computed for a frozen node
+        mutable std::atomic<std::uint64_t> cached_hash = 0;
     };
 
     using shared_node = node::shared_node;
@@ -49,55 +186,133 @@ namespace vole::datamodel {
 
     class array_node : public node {
     public:
-        explicit array_node(std::string name)
+        explicit array_node(node_name name)
             : node(std::move(name)) {}
 
         std::string type() const override;
         virtual void add_child(shared_node node);
         [[nodiscard]] shared_node get_child(size_t index) const;
         [[nodiscard]] const node_list& get_children() const;
+
+        /**
+         * @return The number of elements
+         */
+        [[nodiscard]] virtual size_t size() const;
+
+        /**
+         * Get one element for reading it once. Arrays which can produce an
+         * element without building all of them, such as columnar arrays,
+         * return a node built for the caller only, so reading the elements
+         * one after another holds only one of them at a time.
+         * @throws no_such_element_exception if the index is out of range
+         */
+        [[nodiscard]] virtual shared_node element(size_t index) const;
+
         void apply(const_node_visitor &visitor) const override;
         void apply(node_visitor &visitor) override;
         bool operator==(const node &) const override;
+        void freeze() override;
+    protected:
+        [[nodiscard]] std::uint64_t compute_hash() const override;
+
+        /**
+         * Called before the children are accessed. Subclasses which defer
+         * building their children override this to populate them on first
+         * use through assign_children(). Overrides must be thread-safe.
+         */
+        virtual void materialize() const {}
+        void assign_children(node_list nodes) const;
     private:
-        node_list children;
+        // Mutable so that deferred children can be filled in from materialize()
+        mutable node_list children;
     };
 
     using literal_value = std::variant<
         bool_type,
         null_type,
         num_type,
-        string_type
+        string_type,
+        binary_type
     >;
 
+    /**
+     * Render a number the way literal nodes do: integral values without
+     * a fractional part, anything else with six decimals.
+     */
+    [[nodiscard]] std::string render_num(num_type n);
+
+    /**
+     * Append the decimal text of an integer. This is the fast path for
+     * integral numbers and loop counters, which never goes through fmt.
+     */
+    void append_integer(std::string &output, std::int64_t value);
+
+    /**
+     * Hash a value the way literal nodes hash theirs. The overloads for
+     * single types hash values stored outside of a literal_value.
+     */
+    [[nodiscard]] std::uint64_t hash_literal(const literal_value &value);
+    [[nodiscard]] std::uint64_t hash_literal(num_type value);
+    [[nodiscard]] std::uint64_t hash_literal(const string_type &value);
+
+    /**
+     * Hash raw bytes under the per-process key of the subtree hashes, e.g.
+     * to tell whether a file changed without keeping its content
+     */
+    [[nodiscard]] std::uint64_t keyed_digest(std::string_view data);
+
     class literal_node : public node {
     public:
-        explicit literal_node(std::string name, literal_value value)
+        explicit literal_node(node_name name, literal_value value)
             : node(std::move(name)), value(std::move(value)) {}
 
         [[nodiscard]] std::string type() const override;
         [[nodiscard]] std::string render() const;
+
+        [[nodiscard]] const literal_value& get_value() const {
+            return value;
+        }
+
         void apply(const_node_visitor &visitor) const override;
         void apply(node_visitor &visitor) override;
         bool operator==(const node &) const override;
     protected:
+        [[nodiscard]] std::uint64_t compute_hash() const override;
+
         literal_value value;
     };
 
     class object_node : public node {
     public:
-        explicit object_node(std::string name)
+        explicit object_node(node_name name)
             : node(std::move(name)) {}
 
         [[nodiscard]] std::string type() const override;
         void add_child(shared_node node);
         [[nodiscard]] shared_node get_child(std::string_view name) const;
+        [[nodiscard]] shared_node get_child(const node_name &name) const;
+
+        [[nodiscard]] shared_node get_child(const char *name) const {
+            return get_child(std::string_view(name));
+        }
         [[nodiscard]] const node_list& get_children() const;
         void apply(const_node_visitor &visitor) const override;
         void apply(node_visitor &visitor) override;
         bool operator==(const node &) const override;
+        void freeze() override;
+    protected:
+        [[nodiscard]] std::uint64_t compute_hash() const override;
+
+        /**
+         * Called before the children are accessed. Subclasses which defer
+         * building their children override this to populate them on first
+         * use through assign_children(). Overrides must be thread-safe.
+         */
+        virtual void materialize() const {}
+        void assign_children(node_list nodes) const;
     private:
-        node_list children;
+        // Mutable so that deferred children can be filled in from materialize()
+        mutable node_list children;
     };
 
     template <typename... Args>
@@ -115,6 +330,36 @@ namespace vole::datamodel {
         return std::make_shared<object_node>(std::forward<Args>(args)...);
     }
 
+    /**
+     * A frozen_document owns a node tree which can no longer be modified.
+     *
+     * The tree is frozen and compacted when the document is created. Only
+     * const access is offered afterwards, so one document may be shared by
+     * any number of threads reading it concurrently without locking.
+     */
+    class frozen_document {
+    public:
+        explicit frozen_document(shared_node root);
+
+        [[nodiscard]] const node& root() const {
+            return *root_node;
+        }
+
+        [[nodiscard]] std::shared_ptr<const node> get_root() const {
+            return root_node;
+        }
+
+    private:
+        std::shared_ptr<const node> root_node;
+    };
+
+    /**
+     * Freeze the given node tree and hand it over to a frozen_document.
+     * @param root The root of the tree, which must not be null
+     * @return A read-only document which is safe to share between threads
+     */
+    [[nodiscard]] frozen_document freeze(shared_node root);
+
     class node_visitor {
         friend class literal_node;
         friend class object_node;
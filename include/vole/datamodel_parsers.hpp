@@ -2,18 +2,136 @@
 #pragma once
 
 #include <filesystem>
+#include <limits>
+#include <optional>
 
 #include "vole/datamodel.hpp"
+#include "vole/path_projection.hpp"
 
 namespace vole::datamodel {
 
+    /**
+     * Bounds on what parsing one model may take, so that a single broken or
+     * hostile input cannot exhaust the memory or stack of a process rendering
+     * many models. Exceeding a limit throws a limit_exceeded_exception naming
+     * where in the model it happened.
+     */
+    struct parse_limits {
+        static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+        // Nesting of arrays and objects, which also bounds the recursion of later tree walks
+        size_t max_depth = 512;
+        size_t max_nodes = unlimited;
+        // Length of strings, member names and binaries in bytes. Checked once
+        // the value has been read whole, so this bounds what goes into the
+        // tree, not the peak memory of reading one value.
+        size_t max_string_length = unlimited;
+        // Estimated memory taken by the nodes built, in bytes
+        size_t max_bytes = unlimited;
+    };
+
     class parser {
     public:
         virtual ~parser() = default;
         [[nodiscard]] virtual shared_node parse(std::string_view input) = 0;
+
+        void set_limits(const parse_limits &limits) {
+            this->limits = limits;
+        }
+
+        [[nodiscard]] const parse_limits &get_limits() const {
+            return limits;
+        }
+
+    protected:
+        parse_limits limits;
     };
 
     class json_parser : public parser {
+    public:
+        json_parser();
+
+        /**
+         * Create a parser which only builds the nodes selected by the given
+         * projection. Subtrees outside of it are scanned past without
+         * allocating any nodes. Skipped array elements which precede an
+         * explicitly requested index are kept as null placeholders.
+         */
+        explicit json_parser(path_projection projection);
+
+        [[nodiscard]] shared_node parse(std::string_view input) override;
+    private:
+        std::optional<path_projection> projection;
+    };
+
+    /**
+     * Parses CBOR (RFC 8949) encoded input into the same node tree as
+     * json_parser. Byte strings become binary literal nodes.
+     */
+    class cbor_parser : public parser {
+    public:
+        cbor_parser();
+        explicit cbor_parser(path_projection projection);
+        [[nodiscard]] shared_node parse(std::string_view input) override;
+    private:
+        std::optional<path_projection> projection;
+    };
+
+    /**
+     * Parses MessagePack encoded input into the same node tree as
+     * json_parser. Bin and ext values become binary literal nodes.
+     */
+    class msgpack_parser : public parser {
+    public:
+        msgpack_parser();
+        explicit msgpack_parser(path_projection projection);
+        [[nodiscard]] shared_node parse(std::string_view input) override;
+    private:
+        std::optional<path_projection> projection;
+    };
+
+    /**
+     * The encodings which vole is able to read models from
+     */
+    enum class model_format {
+        json,
+        cbor,
+        msgpack,
+    };
+
+    /**
+     * Pick the model format from a file extension: `.cbor` selects CBOR,
+     * `.msgpack` and `.mpk` select MessagePack, anything else is JSON.
+     */
+    [[nodiscard]] model_format format_from_path(const std::filesystem::path &path);
+
+    /**
+     * Look up a model format by its name, as used on the command line.
+     * @throws unsupported_element_exception if the name is not known
+     */
+    [[nodiscard]] model_format format_from_name(std::string_view name);
+
+    [[nodiscard]] std::string_view format_name(model_format format);
+
+    [[nodiscard]] std::unique_ptr<parser> make_parser(model_format format, const parse_limits &limits = {});
+
+    /**
+     * The lazy_json_parser defers building the node tree until it is used.
+     *
+     * Parsing only copies the input and records a structural index holding
+     * the byte offsets of every array and object. The children of a node are
+     * built the first time they are accessed through get_child or
+     * get_children and are cached afterwards. Materialization is
+     * thread-safe, so a lazily parsed tree may be read from several threads.
+     *
+     * Only the bracket structure is validated up front. Malformed values are
+     * reported with a syntax_exception when their parent is materialized.
+     *
+     * The depth, string length and byte limits are checked up front, the
+     * byte budget against the copy of the input. Nodes are not counted, as
+     * they only exist once materialized.
+     */
+    class lazy_json_parser : public parser {
     public:
         [[nodiscard]] shared_node parse(std::string_view input) override;
     };
@@ -45,4 +45,22 @@ namespace vole {
         [[nodiscard]] std::string_view type() const noexcept(true) override;
     };
 
+
+    class syntax_exception : public vole::exception {
+    public:
+        explicit syntax_exception(std::string text);
+        [[nodiscard]] std::string_view type() const noexcept(true) override;
+    };
+
+
+    /**
+     * Thrown when an input needs more resources than it is allowed to use,
+     * e.g. a model nested deeper than its parser accepts
+     */
+    class limit_exceeded_exception : public vole::exception {
+    public:
+        explicit limit_exceeded_exception(std::string text);
+        [[nodiscard]] std::string_view type() const noexcept(true) override;
+    };
+
 }
\ No newline at end of file
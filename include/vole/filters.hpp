@@ -0,0 +1,99 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "vole/output_sink.hpp"
+#include "vole/profiler.hpp"
+#include "vole/scope.hpp"
+
+namespace vole {
+
+    /**
+     * A stage of a filter pipeline such as `${name | upper}`. A stage is a
+     * sink which transforms the text written into it and passes it on to
+     * the next sink as it goes, so chained stages never build intermediate
+     * strings.
+     */
+    class filter_stage : public output_sink {
+    public:
+        explicit filter_stage(output_sink &next)
+            : next(next) {}
+
+        /**
+         * Pass on any text this stage still holds back to the next sink,
+         * without flushing the sinks after it
+         */
+        virtual void drain() {}
+
+        void flush() override {
+            drain();
+            next.flush();
+        }
+
+    protected:
+        output_sink &next;
+    };
+
+    /**
+     * The text filters which can follow a value in a render section. Each
+     * is known by name and creates its stage on top of the next sink.
+     *
+     * `dump` is not a text filter: it selects how the value itself is
+     * rendered, and so may only come first.
+     */
+    class filter_registry {
+    public:
+        using factory = std::function<std::unique_ptr<filter_stage>(output_sink &next)>;
+
+        /**
+         * A registry holding the built-in filters, `upper` and `lower`
+         */
+        filter_registry();
+
+        /**
+         * Add a filter, replacing any filter of the same name
+         */
+        void add(std::string name, factory create);
+
+        /**
+         * @throws no_such_element_exception if no filter has the given name
+         */
+        [[nodiscard]] std::unique_ptr<filter_stage> create(std::string_view name, output_sink &next) const;
+
+        /**
+         * @return The registry used when none is given
+         */
+        [[nodiscard]] static const filter_registry &builtin();
+
+    private:
+        std::map<std::string, factory, std::less<>> filters;
+    };
+
+    /**
+     * Render the expression of a render section, such as `enum.name`,
+     * `model | dump` or `name | lower | upper`, into a sink.
+     *
+     * The value is streamed through the filter stages straight into the
+     * sink. A dump writes the tree in chunks as it walks it, so the text of
+     * the whole subtree is never held in memory. Once the value is written,
+     * the stages are drained; the sink itself is not flushed.
+     * @throws syntax_exception if `dump` follows another filter or a filter name is empty
+     * @throws no_such_element_exception if the variable or a filter does not exist
+     * @throws invalid_operation_exception if a non-literal is rendered without `dump`
+     */
+    void render_expression(const scope_frame &scope, std::string_view expression, output_sink &sink,
+                           const filter_registry &filters = filter_registry::builtin());
+
+    /**
+     * Render the expression of a render section like the overload above,
+     * attributing the time to the section's place in its template when profiling
+     * @param where The template file and the offset of the section's `${`
+     */
+    void render_expression(const scope_frame &scope, std::string_view expression, const template_location &where,
+                           output_sink &sink, const filter_registry &filters = filter_registry::builtin());
+
+}
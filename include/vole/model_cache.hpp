@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "vole/datamodel.hpp"
+#include "vole/datamodel_parsers.hpp"
+
+namespace vole {
+
+    /**
+     * Read a file from the filesystem and return it as a string
+     * @param path The path to the file
+     * @return A std::string containing the contents of the file
+     */
+    [[nodiscard]] std::string read_file(const std::filesystem::path &path);
+
+    /**
+     * The model_cache keeps parsed models resident between uses.
+     *
+     * A cached model is reused as long as the modification time and size of
+     * its file are unchanged. When they change, the file is read again and
+     * only parsed if its content differs, which is told by a keyed digest
+     * of the content. Models are handed out as frozen documents and the
+     * cache itself is thread-safe.
+     *
+     * At most `capacity` models are kept. Beyond that, the model used least
+     * recently is dropped; documents handed out earlier stay valid.
+     */
+    class model_cache {
+    public:
+        static constexpr size_t default_capacity = 64;
+
+        model_cache() = default;
+
+        /**
+         * @param limits The resources parsing one model may take
+         * @param capacity The number of models kept at most, at least one
+         */
+        explicit model_cache(const datamodel::parse_limits &limits, size_t capacity = default_capacity);
+
+        /**
+         * Get the model stored in a file, parsing it only if needed.
+         * @param path The model file
+         * @param format The encoding of the model. Guessed from the file extension if empty.
+         * @return The parsed model
+         */
+        [[nodiscard]] datamodel::frozen_document get(
+            const std::filesystem::path &path,
+            std::optional<datamodel::model_format> format = std::nullopt);
+
+        /**
+         * Drop the cached model of a file, if any
+         */
+        void invalidate(const std::filesystem::path &path);
+
+        void clear();
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        struct entry {
+            std::filesystem::file_time_type modified;
+            std::uintmax_t file_size;
+            // keyed_digest() of what the model was parsed from
+            std::uint64_t digest;
+            datamodel::model_format format;
+            datamodel::frozen_document document;
+            std::uint64_t last_used;
+        };
+
+        static std::string cache_key(const std::filesystem::path &path);
+        // Drop the least recently used models until there is room for one more
+        void make_room();
+
+        const datamodel::parse_limits limits;
+        const size_t capacity = default_capacity;
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, entry> entries;
+        std::uint64_t uses = 0;
+    };
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vole/datamodel.hpp"
+#include "vole/datamodel_parsers.hpp"
+#include "vole/model_cache.hpp"
+
+namespace vole {
+
+    enum class mount_mode {
+        // The mounted model takes the place of whatever was at the path
+        replace,
+        // Objects are merged member by member, anything else is replaced
+        merge,
+    };
+
+    /**
+     * A model file which becomes part of a composed model
+     */
+    struct model_mount {
+        // Member names from the root to the mount point, e.g. `config.network`. Empty for the root itself.
+        std::string path;
+        // The model file. The file name may be a glob using '*' and '?'.
+        std::filesystem::path file;
+        mount_mode mode = mount_mode::replace;
+        // Guessed from the file extension if empty
+        std::optional<datamodel::model_format> format;
+    };
+
+    /**
+     * Parse a mount as given on the command line, i.e. `path=file` to
+     * replace what is at the path or `path+=file` to merge into it.
+     * @throws syntax_exception if the mount has no '='
+     */
+    [[nodiscard]] model_mount parse_mount(std::string_view spec);
+
+    /**
+     * Replace the mounts whose file name is a glob by one mount per matching
+     * file, in sorted order. Each match is mounted below the path of the
+     * glob, at a member named after its file name without the extension.
+     * @throws no_such_element_exception if a glob matches no file
+     */
+    [[nodiscard]] std::vector<model_mount> expand_mounts(const std::vector<model_mount> &mounts);
+
+    /**
+     * Build one model from several model files. The files are taken from
+     * the cache, so they are read and parsed concurrently and only when they
+     * changed, and then mounted under one root object in the given order.
+     * Subtrees of the mounted models are shared, not copied. Only array
+     * elements, whose names follow the name of their array, are copied
+     * under the name of the mount point.
+     * @param mounts The models to mount. Globs are expanded.
+     * @param cache The cache to take the models from
+     * @param threads The number of files loaded at once. Zero picks one per hardware thread.
+     * @return The composed model
+     * @throws invalid_operation_exception if a mount point lies below a value which is not an object
+     */
+    [[nodiscard]] datamodel::frozen_document compose_models(const std::vector<model_mount> &mounts,
+                                                            model_cache &cache, size_t threads = 0);
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vole/datamodel.hpp"
+
+namespace vole::datamodel {
+
+    enum class change_kind {
+        // The path only exists in the newer tree
+        added,
+        // The path only exists in the older tree
+        removed,
+        // The path exists in both trees, but its type or value differs
+        changed,
+    };
+
+    /**
+     * One difference between two node trees
+     */
+    struct model_change {
+        change_kind kind;
+        // Accessor path relative to the root, e.g. `enums[2].name`. Empty for the root itself.
+        std::string path;
+
+        bool operator==(const model_change &) const = default;
+    };
+
+    /**
+     * Compute the structural differences between two node trees.
+     *
+     * Object members are matched by name, array elements by index. A node
+     * whose type changed is reported once as changed, without descending
+     * into it. Subtrees which are shared by both trees are skipped, so
+     * diffing two frozen trees which share their unchanged parts, such as
+     * models composed from the same cached files, takes time proportional
+     * to the size of the changes. Frozen subtrees with equal
+     * subtree_hash() are skipped without being walked, so separately
+     * parsed frozen trees cost their hashing once, and then time
+     * proportional to the changes. The names of the roots are not compared.
+     * @return The changes in document order, older members before added ones
+     */
+    [[nodiscard]] std::vector<model_change> diff(const node &before, const node &after);
+
+}
@@ -1,11 +1,11 @@
-
 #pragma once
 
 #include <cstdint>
 #include <string>
-#include <sstream>
+#include <string_view>
 
 #include "vole/datamodel.hpp"
+#include "vole/output_sink.hpp"
 
 namespace vole {
     /**
@@ -22,12 +22,38 @@ namespace vole {
          * @return A string representing the tree on one or more lines
          */
         std::string render(const datamodel::node &node);
+
+        /**
+         * Render the given node-tree into a sink, one line per node. The
+         * lines are written as they are produced, so the text of the whole
+         * tree is never held in memory. Columnar arrays are printed from
+         * their columns one element at a time, and lazy subtrees are parsed
+         * as they are reached.
+         * @param node The root of the tree
+         * @param sink Receives the text in chunks. Not flushed, so a dump
+         *        within a larger output does not force the output out.
+         */
+        void render(const datamodel::node &node, output_sink &sink);
     protected:
         void on_enter(const datamodel::array_node &node) override;
         void on_enter(const datamodel::literal_node &node) override;
         void on_enter(const datamodel::object_node &node) override;
+
+        /**
+         * Write one line at the indentation of the current depth
+         * @param text The line, without indentation or line break
+         */
         virtual void append(std::string_view text);
+
+        /**
+         * Write the line of one node. Passes `type{name}` on to
+         * append(std::string_view), reusing one buffer for all lines.
+         * @param type The type of the node, as returned by node::type()
+         * @param name The name of the node
+         */
+        virtual void append(std::string_view type, std::string_view name);
     private:
-        std::stringstream renderer;
+        output_sink *sink = nullptr;
+        std::string line;
     };
 }
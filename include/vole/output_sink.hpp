@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace vole {
+
+    /**
+     * The destination of rendered text. Renderers write their output in
+     * pieces as they produce it, instead of assembling it in a string first.
+     */
+    class output_sink {
+    public:
+        virtual ~output_sink() = default;
+
+        virtual void write(std::string_view text) = 0;
+
+        void write(char c) {
+            write(std::string_view(&c, 1));
+        }
+
+        /**
+         * Pass on anything which is still buffered
+         */
+        virtual void flush() {}
+    };
+
+    /**
+     * Appends everything written to a string
+     */
+    class string_sink : public output_sink {
+    public:
+        explicit string_sink(std::string &target)
+            : target(target) {}
+
+        using output_sink::write;
+        void write(std::string_view text) override;
+
+    private:
+        std::string &target;
+    };
+
+    /**
+     * Writes everything to a standard stream
+     */
+    class stream_sink : public output_sink {
+    public:
+        explicit stream_sink(std::ostream &target)
+            : target(target) {}
+
+        using output_sink::write;
+        void write(std::string_view text) override;
+        void flush() override;
+
+    private:
+        std::ostream &target;
+    };
+
+    /**
+     * Collects small writes into a fixed-size buffer and passes them on in
+     * chunks, so that the next sink sees few large writes no matter how
+     * much text goes through. Text still buffered on destruction is
+     * dropped, so call flush() or drain() once done.
+     */
+    class chunked_sink : public output_sink {
+    public:
+        static constexpr size_t chunk_size = 16 * 1024;
+
+        explicit chunked_sink(output_sink &next)
+            : next(next) {}
+
+        chunked_sink(const chunked_sink &) = delete;
+        chunked_sink &operator=(const chunked_sink &) = delete;
+
+        using output_sink::write;
+        void write(std::string_view text) override;
+        void flush() override;
+
+        /**
+         * Pass the buffered text on, without flushing the next sink
+         */
+        void drain();
+
+    private:
+        output_sink &next;
+        std::array<char, chunk_size> buffer;
+        size_t used = 0;
+    };
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "vole/output_sink.hpp"
+#include "vole/thread_pool.hpp"
+
+namespace vole {
+
+    /**
+     * Produces the content of a file by writing it into the sink it is given
+     */
+    using content_producer = std::move_only_function<void(output_sink &sink)>;
+
+    /**
+     * Write a file so that readers see either its previous content or the
+     * complete new one: the content goes to a temporary file in the same
+     * directory, which then replaces the target.
+     * @throws std::system_error if the file cannot be written
+     */
+    void write_file_atomically(const std::filesystem::path &path, std::string_view content);
+
+    /**
+     * Write a file atomically like the overload above, streaming the content
+     * into the temporary file as it is produced instead of taking it whole.
+     * If the producer throws, the temporary file is removed and the target
+     * is left untouched.
+     */
+    void write_file_atomically(const std::filesystem::path &path, content_producer produce);
+
+    /**
+     * A file the output_writer failed to write
+     */
+    struct write_failure {
+        std::filesystem::path path;
+        std::string message;
+    };
+
+    /**
+     * The output_writer takes finished output buffers and writes them to
+     * disk on a pool of background threads, so that producing thousands of
+     * small files does not serialize rendering on filesystem latency.
+     *
+     * Every directory is created once, no matter how many files go into it,
+     * and each file is written atomically. Failures are collected and
+     * handed back by wait(). The writer is thread-safe.
+     */
+    class output_writer {
+    public:
+        /**
+         * @param threads The number of writer threads. Zero picks one per hardware thread.
+         */
+        explicit output_writer(size_t threads = 0);
+
+        /**
+         * Finishes all queued writes. Failures not collected by wait() are dropped.
+         */
+        ~output_writer() = default;
+
+        output_writer(const output_writer &) = delete;
+        output_writer &operator=(const output_writer &) = delete;
+
+        /**
+         * Queue a file to be written. Returns immediately, without touching the disk.
+         * Writing the same path twice before wait() leaves either content.
+         * @param path The file to create or replace. Missing directories are created.
+         * @param content The complete content of the file
+         */
+        void write(std::filesystem::path path, std::string content);
+
+        /**
+         * Write a file whose content is produced on the calling thread, straight
+         * into the file, so it is never held in memory as a whole. Producing is
+         * usually the expensive part, and stays on the caller's threads instead
+         * of competing with them from the writer threads. Exceptions of the
+         * producer are reported by wait() like failed writes.
+         * @param path The file to create or replace. Missing directories are created.
+         * @param produce Writes the content of the file into the sink it is given
+         */
+        void write(const std::filesystem::path &path, content_producer produce);
+
+        /**
+         * Wait until every queued file has been written
+         * @return The writes which failed since the last call, in no particular order
+         */
+        [[nodiscard]] std::vector<write_failure> wait();
+
+    private:
+        void write_now(const std::filesystem::path &path, content_producer &produce);
+        // Writes now, collecting a failure for wait() instead of throwing
+        void write_reporting(const std::filesystem::path &path, content_producer &produce);
+
+        std::mutex mutex;
+        std::condition_variable idle;
+        size_t pending = 0;
+        std::vector<write_failure> failures;
+
+        std::mutex directories_mutex;
+        std::unordered_set<std::string> created_directories;
+
+        // Last, so it is joined before the state its tasks use is destroyed
+        thread_pool pool;
+    };
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "vole/datamodel.hpp"
+
+namespace vole::datamodel {
+
+    namespace detail {
+
+        /**
+         * The indices of the children leading from the root to a node.
+         * Compared lexicographically, positions are in pre-order.
+         */
+        using tree_position = std::vector<size_t>;
+
+        /**
+         * The type-erased visit step of a parallel traversal.
+         *
+         * A traversal visits the tree in parts, each a run of siblings which
+         * is contiguous in pre-order. Before a worker visits the nodes of a
+         * part, it calls begin_part() with the position of its first node.
+         */
+        class traversal_callback {
+        public:
+            virtual ~traversal_callback() = default;
+            virtual void begin_part(size_t /*worker*/, const tree_position &/*position*/) {}
+            virtual void visit(size_t worker, const node &node, size_t depth) = 0;
+        };
+
+        /**
+         * @return The number of workers a traversal with the given thread count uses
+         */
+        [[nodiscard]] size_t traversal_workers(size_t threads);
+
+        /**
+         * Visit every node below and including the root exactly once, on
+         * traversal_workers(threads) workers. The calling thread is worker 0,
+         * the others run on a thread pool shared by all traversals.
+         * Rethrows the first exception thrown by the callback.
+         */
+        void run_traversal(const node &root, size_t threads, traversal_callback &callback);
+
+    }
+
+    /**
+     * Visit every node of a tree on several threads and combine the results.
+     *
+     * The children of arrays and objects are split into ranges which idle
+     * workers steal from busy ones, so unbalanced trees still keep every
+     * thread busy. Each run of siblings is folded into a state of its own,
+     * which needs no locking. Once all nodes are visited, the states are
+     * reduced in pre-order of the tree, no matter which worker visited
+     * what, so the result is the same on every run. It is the one of a
+     * sequential walk as long as the reduce step is associative.
+     *
+     * The tree is only read. It must not be modified during the traversal,
+     * which a frozen_document guarantees.
+     * @param root The node to start from
+     * @param visit Called as visit(node, depth, state) for every node, in no particular order
+     * @param reduce Called as reduce(total, state) to fold each further state into the first, in tree order
+     * @param threads The number of threads to use. Zero picks one per hardware thread.
+     * @return The reduced state of all parts
+     */
+    template <typename State, typename Visit, typename Reduce>
+    State parallel_reduce(const node &root, Visit &&visit, Reduce &&reduce, size_t threads = 0) {
+        struct part {
+            detail::tree_position position;
+            State state{};
+        };
+
+        class callback_t : public detail::traversal_callback {
+        public:
+            callback_t(Visit &visit, std::vector<std::vector<part>> &parts)
+                : visit_node(visit), parts(parts) {}
+
+            void begin_part(size_t worker, const detail::tree_position &position) override {
+                parts[worker].push_back({position});
+            }
+
+            void visit(size_t worker, const node &node, size_t depth) override {
+                visit_node(node, depth, parts[worker].back().state);
+            }
+
+        private:
+            Visit &visit_node;
+            std::vector<std::vector<part>> &parts;
+        };
+
+        // Each worker only appends to its own list
+        std::vector<std::vector<part>> parts(detail::traversal_workers(threads));
+        callback_t callback(visit, parts);
+        detail::run_traversal(root, threads, callback);
+
+        std::vector<part *> ordered;
+        for (auto &worker_parts : parts) {
+            for (auto &visited : worker_parts) {
+                ordered.push_back(&visited);
+            }
+        }
+        std::sort(ordered.begin(), ordered.end(),
+            [](const part *a, const part *b) { return a->position < b->position; });
+        // The root's part comes first, so there always is one
+        for (size_t i = 1; i < ordered.size(); i++) {
+            reduce(ordered[0]->state, ordered[i]->state);
+        }
+        return std::move(ordered[0]->state);
+    }
+
+    /**
+     * A node_descender which can also descend a tree on several threads.
+     *
+     * Descenders which only look at each node on its own, such as counters,
+     * validators or searches, opt in by deriving from this class instead of
+     * node_descender. apply() still descends on the calling thread as
+     * before, while descend_parallel() calls on_enter() concurrently from
+     * several workers. Per-thread state is kept in containers sized in
+     * on_start() and indexed by get_worker().
+     */
+    class parallel_descender : public node_descender {
+    public:
+        /**
+         * Call on_enter() for every node of the tree, spreading the subtrees
+         * over several threads. on_exit() is not called, since the children
+         * of a node may still be in progress on other threads at that point.
+         * @param threads The number of threads to use. Zero picks one per hardware thread.
+         */
+        void descend_parallel(const node &root, size_t threads = 0);
+
+    protected:
+        /**
+         * Called before a parallel descent with the number of workers it uses
+         */
+        virtual void on_start(size_t /*workers*/) {}
+
+        /**
+         * @return The depth of the node being entered, in either mode
+         */
+        [[nodiscard]] size_t get_depth() const;
+
+        /**
+         * @return The index of the worker calling on_enter(), always 0 outside of descend_parallel()
+         */
+        [[nodiscard]] size_t get_worker() const;
+    };
+
+}
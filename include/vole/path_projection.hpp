@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vole::datamodel {
+
+    /**
+     * A path_projection describes which parts of a document a consumer
+     * is interested in, so that a parser can skip everything else.
+     *
+     * Paths use the accessor syntax of template expressions, relative to
+     * the root node: `enums[0].name` or `enums[*].items`. A `*` segment
+     * (or `[*]`) matches any member name or array index. A path selects
+     * the node it names including its entire subtree, along with the
+     * chain of parents leading to it.
+     */
+    class path_projection {
+    public:
+        /**
+         * The set of projection paths which are still active at a
+         * position of the document. Obtained by walking down from root().
+         */
+        class selection {
+            friend class path_projection;
+        public:
+            /**
+             * @return true if nothing below this position was requested
+             */
+            [[nodiscard]] bool empty() const {
+                return !whole && steps.empty();
+            }
+
+            /**
+             * @return true if the entire subtree at this position was requested
+             */
+            [[nodiscard]] bool is_whole() const {
+                return whole;
+            }
+
+        private:
+            bool whole = false;
+            std::vector<size_t> steps;
+        };
+
+        path_projection();
+        explicit path_projection(const std::vector<std::string> &paths);
+
+        /**
+         * Add another path to the projection.
+         * @param path An accessor path such as `enums[*].name`. An empty
+         *        path selects the whole document.
+         * @throws syntax_exception if the path cannot be parsed
+         */
+        void add_path(std::string_view path);
+
+        [[nodiscard]] selection root() const;
+        [[nodiscard]] selection select_member(const selection &parent, std::string_view name) const;
+        [[nodiscard]] selection select_element(const selection &parent, size_t index) const;
+
+        /**
+         * Determine whether an explicit index beyond the given one is still
+         * requested. Skipped elements before such an index must be kept as
+         * placeholders so that the requested index stays addressable.
+         */
+        [[nodiscard]] bool selects_later_element(const selection &parent, size_t index) const;
+
+    private:
+        struct step {
+            std::map<std::string, size_t, std::less<>> members;
+            std::map<size_t, size_t> elements;
+            size_t any = 0;
+            bool terminal = false;
+        };
+
+        size_t add_member_step(size_t from, std::string_view name);
+        size_t add_element_step(size_t from, size_t index);
+        size_t add_any_step(size_t from);
+        void advance(selection &result, size_t to) const;
+
+        // Step 0 is the document root. A value of 0 in any/members/elements
+        // means "no transition", since no step can lead back to the root.
+        std::vector<step> steps;
+    };
+
+}
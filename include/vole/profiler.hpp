@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <source_location>
+#include <string_view>
+
+namespace vole {
+
+    /**
+     * The quantities a profile zone can count besides time
+     */
+    enum class profile_counter {
+        // Loop iterations, e.g. of a `@for@` block
+        iterations,
+        // Variables and members looked up in the model
+        lookups,
+        // Bytes of output produced
+        output_bytes,
+    };
+
+    /**
+     * A position in a template, such as the `@for@` or `${...}` section a
+     * zone executes. The offset is the one of the section's token.
+     */
+    struct template_location {
+        std::string_view file;
+        size_t offset;
+    };
+
+    /**
+     * The profiler records zones, i.e. timed sections of work, together
+     * with what they counted. It is opt-in twice: the instrumentation
+     * macros below only exist in builds with VOLE_ENABLE_PROFILER defined,
+     * and even then nothing is recorded until enable() is called. While
+     * disabled, a zone costs one relaxed atomic load.
+     *
+     * Zones of template execution are attributed to the template location
+     * they run, reported as file:line:column once the template source is
+     * registered and as file@offset before. Other zones are attributed to
+     * vole's own source code.
+     *
+     * Each thread records into its own buffer, so zones on different
+     * threads do not contend. Labels and template files are interned, so
+     * recording a zone whose label was seen before does not allocate,
+     * apart from growing the buffer.
+     */
+    class profiler {
+    public:
+        static constexpr bool compiled_in =
+#if defined(VOLE_ENABLE_PROFILER)
+            true;
+#else
+            false;
+#endif
+
+        [[nodiscard]] static bool enabled() {
+            return active.load(std::memory_order_relaxed);
+        }
+
+        static void enable();
+        static void disable();
+
+        /**
+         * Drop everything recorded so far
+         */
+        static void reset();
+
+        /**
+         * Make the lines of a template known, so that reports translate the
+         * offsets of its zones into lines and columns. Registering a file
+         * again replaces its lines.
+         */
+        static void register_template(std::string_view file, std::string_view source);
+
+        /**
+         * Write the recorded zones in the Chrome trace_event format, which
+         * trace viewers such as Perfetto or chrome://tracing load directly
+         */
+        static void write_trace(std::ostream &out);
+
+        /**
+         * Write one line per distinct stack of zones, as `outer;inner microseconds`
+         * of time spent in the innermost zone itself. This is the folded
+         * format flame graph tools read.
+         */
+        static void write_folded(std::ostream &out);
+
+        /**
+         * Write a table of the zones by label and location, with their calls,
+         * total and self time and counters, most expensive first
+         */
+        static void write_summary(std::ostream &out);
+
+    private:
+        inline static std::atomic<bool> active = false;
+    };
+
+    /**
+     * A zone which is timed from construction to destruction. Usually
+     * created through VOLE_PROFILE_ZONE.
+     */
+    class profile_zone {
+    public:
+        /**
+         * @param label What the zone does. Zones with the same label and location are summarized together.
+         */
+        explicit profile_zone(std::string_view label,
+                              std::source_location where = std::source_location::current()) {
+            if (profiler::enabled()) {
+                begin(label, where, nullptr);
+            }
+        }
+
+        /**
+         * @param label What the zone does, e.g. `for` or `render`
+         * @param where The template section the zone executes, which its time is attributed to
+         */
+        profile_zone(std::string_view label, const template_location &where,
+                     std::source_location code = std::source_location::current()) {
+            if (profiler::enabled()) {
+                begin(label, code, &where);
+            }
+        }
+
+        ~profile_zone() {
+            if (open) {
+                end();
+            }
+        }
+
+        profile_zone(const profile_zone &) = delete;
+        profile_zone &operator=(const profile_zone &) = delete;
+
+    private:
+        void begin(std::string_view label, const std::source_location &where, const template_location *in_template);
+        void end();
+
+        bool open = false;
+    };
+
+    /**
+     * Add to a counter of the innermost open zone of the calling thread.
+     * Does nothing if the profiler is disabled or no zone is open.
+     */
+    void profile_count(profile_counter counter, std::uint64_t amount);
+
+}
+
+#if defined(VOLE_ENABLE_PROFILER)
+    #define VOLE_PROFILE_CONCAT_INNER(a, b) a##b
+    #define VOLE_PROFILE_CONCAT(a, b) VOLE_PROFILE_CONCAT_INNER(a, b)
+    // Time the rest of the enclosing block
+    #define VOLE_PROFILE_ZONE(label) \
+        const ::vole::profile_zone VOLE_PROFILE_CONCAT(vole_profile_zone_, __LINE__)(label)
+    // Time the rest of the enclosing block, attributed to a template section
+    #define VOLE_PROFILE_TEMPLATE_ZONE(label, file, offset) \
+        const ::vole::profile_zone VOLE_PROFILE_CONCAT(vole_profile_zone_, __LINE__)( \
+            label, ::vole::template_location{file, offset})
+    // Count into the innermost zone, e.g. VOLE_PROFILE_COUNT(iterations, 1)
+    #define VOLE_PROFILE_COUNT(counter, amount) \
+        ::vole::profile_count(::vole::profile_counter::counter, amount)
+#else
+    #define VOLE_PROFILE_ZONE(label) static_cast<void>(0)
+    #define VOLE_PROFILE_TEMPLATE_ZONE(label, file, offset) static_cast<void>(::vole::template_location{file, offset})
+    #define VOLE_PROFILE_COUNT(counter, amount) static_cast<void>(0)
+#endif
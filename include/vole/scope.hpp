@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "vole/datamodel.hpp"
+#include "vole/output_sink.hpp"
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    using int_type = std::int64_t;
+
+    /**
+     * The value a name is bound to. Nodes and text are borrowed, never
+     * copied. Loop counters are kept as unboxed integers.
+     */
+    using bound_value = std::variant<
+        const datamodel::node *,
+        std::string_view,
+        datamodel::num_type,
+        datamodel::bool_type,
+        int_type
+    >;
+
+    /**
+     * A scope_frame is one layer of the chain of variable scopes used while
+     * rendering, e.g. the bindings introduced by `@define@` or by one
+     * `@for@` loop.
+     *
+     * Frames are meant to live on the stack and borrow everything: their
+     * parent, the names and the bound values must outlive the frame.
+     * Pushing or popping a frame is a constructor or destructor call, and
+     * rebinding a name the frame already holds overwrites it in place, so a
+     * loop can rebind its variables each iteration without allocating.
+     */
+    class scope_frame {
+    public:
+        /**
+         * Create a frame nested in another one
+         */
+        explicit scope_frame(const scope_frame *parent);
+
+        /**
+         * Create the outermost frame. Names not bound anywhere in the chain
+         * are looked up among the members of the model.
+         */
+        explicit scope_frame(const datamodel::node &model);
+
+        scope_frame(const scope_frame &) = delete;
+        scope_frame &operator=(const scope_frame &) = delete;
+
+        /**
+         * Bind a name in this frame, replacing a previous binding of the
+         * same name in this frame. Bindings of outer frames are shadowed.
+         */
+        void bind(std::string_view name, bound_value value);
+
+        /**
+         * Find the innermost binding of a name
+         * @return The bound value, or nothing if the name is not bound
+         */
+        [[nodiscard]] std::optional<bound_value> find(std::string_view name) const;
+
+        /**
+         * Resolve a variable expansion such as `enum.items` or `list[2].name`
+         * against the scope chain, following object members and array indices.
+         * Members of columnar arrays are read from the columns. Text read
+         * that way stays valid while this frame lives, even if the array is
+         * materialized meanwhile. Safe to call from several threads at once
+         * while no thread binds names in the chain.
+         * @throws no_such_element_exception if any step of the path does not exist
+         * @throws syntax_exception if the path is malformed
+         */
+        [[nodiscard]] bound_value resolve(std::string_view path) const;
+
+    private:
+        struct binding {
+            std::string_view name;
+            bound_value value;
+        };
+
+        // Enough for every binding a loop introduces
+        static constexpr size_t inline_capacity = 4;
+
+        const scope_frame *parent = nullptr;
+        const datamodel::node *model = nullptr;
+        std::array<binding, inline_capacity> inline_bindings;
+        size_t inline_count = 0;
+        std::vector<binding> overflow_bindings;
+        // The columns resolved text points into. Guarded, since frames over
+        // a frozen model may be resolved through from several threads.
+        mutable std::mutex pinned_mutex;
+        mutable std::vector<std::shared_ptr<const void>> pinned_columns;
+    };
+
+
+    /**
+     * Write the text of a bound value the way `${...}` renders it
+     * @throws invalid_operation_exception if the value is an array or object node
+     */
+    void write_rendered(const bound_value &value, output_sink &sink);
+
+    /**
+     * The bounds of a counted `@for i in start..end@` loop. The end is exclusive.
+     */
+    struct integer_range {
+        int_type start;
+        int_type end;
+    };
+
+    /**
+     * Evaluate a range expression such as `0..65536` or `1..${count}`. Each
+     * bound is an integer literal or a variable holding an integral number.
+     * @throws syntax_exception if the expression is not a range
+     */
+    [[nodiscard]] integer_range parse_range(const scope_frame &scope, std::string_view expression);
+
+    /**
+     * Run a counted loop. The counter is bound in the given frame as an
+     * unboxed integer, so no node is created for any iteration.
+     * @param frame The frame of the loop
+     * @param name The name of the counter variable
+     * @param range The values to count through
+     * @param body Called once per iteration, after the counter has been bound
+     */
+    template <typename Body>
+    void for_range(scope_frame &frame, std::string_view name, integer_range range, Body &&body) {
+        for (auto i = range.start; i < range.end; i++) {
+            VOLE_PROFILE_COUNT(iterations, 1);
+            frame.bind(name, i);
+            body();
+        }
+    }
+
+}
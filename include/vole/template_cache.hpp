@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vole/template_lexer.hpp"
+
+namespace vole {
+
+    /**
+     * A 64-bit FNV-1a hash. Unlike std::hash it is stable between builds
+     * and platforms.
+     */
+    [[nodiscard]] std::uint64_t stable_hash(std::string_view data);
+
+    /**
+     * A template file which has been read and tokenized, together with the
+     * templates it pulls in through `@IMPORT@` or `@include@`.
+     *
+     * The tokens point into the source held by the same object, which is
+     * why compiled templates are neither copied nor moved.
+     */
+    struct compiled_template {
+        struct dependency {
+            std::filesystem::path path;
+            std::uint64_t source_hash;
+        };
+
+        compiled_template() = default;
+        compiled_template(const compiled_template &) = delete;
+        compiled_template &operator=(const compiled_template &) = delete;
+
+        std::filesystem::path path;
+        std::string source;
+        std::uint64_t source_hash = 0;
+        std::vector<template_token> tokens;
+        // Every template reachable through imports, with the hash it was compiled against
+        std::vector<dependency> dependencies;
+    };
+
+    /**
+     * The template_cache avoids tokenizing templates and resolving their
+     * import chains again when neither they nor any of their imports changed.
+     *
+     * Compiled templates are kept in memory, keyed by path and content hash.
+     * A template and its imports are only read and hashed again when their
+     * size or modification time changed. The cache is thread-safe; files are
+     * read and templates compiled without holding its lock.
+     */
+    class template_cache {
+    public:
+        template_cache() = default;
+
+        /**
+         * Get a compiled template, compiling it only if it or one of its
+         * imports changed since it was last compiled.
+         * @throws no_such_element_exception if the template or an import cannot be read
+         * @throws syntax_exception if a template is malformed or imports itself
+         */
+        [[nodiscard]] std::shared_ptr<const compiled_template> get(const std::filesystem::path &path);
+
+        /**
+         * @return How many templates were actually tokenized by this cache
+         */
+        [[nodiscard]] size_t compilations() const;
+
+    private:
+        using shared_template = std::shared_ptr<const compiled_template>;
+
+        shared_template get(const std::filesystem::path &path, std::vector<std::filesystem::path> &chain);
+        shared_template compile(const std::filesystem::path &path, std::string source, std::uint64_t source_hash,
+                                std::vector<std::filesystem::path> &chain);
+        [[nodiscard]] bool is_current(const compiled_template &compiled) const;
+        // The hash of a file, read again only if its size or modification time changed
+        [[nodiscard]] std::optional<std::uint64_t> file_hash(const std::filesystem::path &path) const;
+
+        struct file_stamp {
+            std::uintmax_t size;
+            std::filesystem::file_time_type modified;
+            std::uint64_t hash;
+        };
+
+        // Guards the maps and the counter only, never held during file I/O
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, shared_template> entries;
+        size_t compiled_count = 0;
+        mutable std::unordered_map<std::string, file_stamp> stamps;
+    };
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace vole {
+
+    enum class token_kind {
+        // Text rendered as-is, including the `@@` and `$$` literals
+        verbatim,
+        // The instructions between the two `@` of a command section
+        command,
+        // The expression between `${` and `}`
+        render,
+    };
+
+    /**
+     * A lexical token of a vole template. The text of every token is a span
+     * into the template source, which must outlive the token.
+     */
+    struct template_token {
+        token_kind kind;
+        std::string_view text;
+        // Offset of the token's first delimiter character in the source
+        size_t offset;
+
+        bool operator==(const template_token &) const = default;
+    };
+
+    /**
+     * Split a template into tokens, following the block table of the
+     * Language Reference. Comment sections are dropped.
+     *
+     * Verbatim text is not copied: each run between two markers becomes a
+     * single span. Markers are located with SSE2 or AVX2 where the CPU
+     * supports it, so long verbatim sections are scanned at memory speed.
+     * @throws syntax_exception if a section is not terminated
+     */
+    [[nodiscard]] std::vector<template_token> tokenize_template(std::string_view source);
+
+    namespace detail {
+
+        /**
+         * Find the next `@` or `$` in the text, using the fastest
+         * implementation the CPU supports.
+         * @return The offset of the marker, or text.size() if there is none
+         */
+        [[nodiscard]] size_t find_marker(std::string_view text, size_t pos);
+
+        /**
+         * The portable implementation of find_marker
+         */
+        [[nodiscard]] size_t find_marker_scalar(std::string_view text, size_t pos);
+
+    }
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vole {
+
+    /**
+     * A fixed-size pool of worker threads executing tasks in submission order.
+     */
+    class thread_pool {
+    public:
+        /**
+         * @param threads The number of workers. Zero picks one per hardware thread.
+         */
+        explicit thread_pool(size_t threads = 0);
+
+        /**
+         * Finishes all queued tasks, then joins the workers
+         */
+        ~thread_pool();
+
+        thread_pool(const thread_pool &) = delete;
+        thread_pool &operator=(const thread_pool &) = delete;
+
+        /**
+         * Queue a task for execution on one of the workers.
+         * @return A future for the result of the task. Exceptions thrown by
+         *         the task are rethrown from the future.
+         */
+        template <typename Function>
+        auto submit(Function &&task) -> std::future<std::invoke_result_t<std::decay_t<Function>>> {
+            using result_type = std::invoke_result_t<std::decay_t<Function>>;
+            std::packaged_task<result_type()> packaged(std::forward<Function>(task));
+            auto result = packaged.get_future();
+            {
+                std::lock_guard lock(mutex);
+                tasks.emplace_back(std::move(packaged));
+            }
+            ready.notify_one();
+            return result;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return workers.size();
+        }
+
+    private:
+        void run();
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::move_only_function<void()>> tasks;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+    };
+
+}
@@ -0,0 +1,355 @@
+#include "vole/columnar_array.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+
+namespace vole::datamodel {
+
+    namespace {
+
+        const object_node *as_flat_object(const node &element) {
+            const auto object = dynamic_cast<const object_node *>(&element);
+            if (object == nullptr) {
+                return nullptr;
+            }
+            const auto &members = object->get_children();
+            const bool flat = std::all_of(members.begin(), members.end(), [](const auto &member) {
+                return dynamic_cast<const literal_node *>(member.get()) != nullptr;
+            });
+            return flat ? object : nullptr;
+        }
+
+
+        const literal_value &member_value(const object_node &object, size_t member) {
+            return static_cast<const literal_node &>(*object.get_children()[member]).get_value();
+        }
+
+
+        /**
+         * Start the column of a member with its first value, using the
+         * narrowest representation which holds it
+         */
+        columnar_array_node::column start_column(const literal_value &value) {
+            if (const auto number = std::get_if<num_type>(&value)) {
+                return std::vector<num_type>{*number};
+            }
+            if (const auto text = std::get_if<string_type>(&value)) {
+                return std::vector<string_type>{*text};
+            }
+            return std::vector<literal_value>{value};
+        }
+
+
+        /**
+         * Append a value to a column, widening the column to mixed values
+         * if it does not hold the type of the value
+         */
+        void append_value(columnar_array_node::column &column, const literal_value &value) {
+            if (auto numbers = std::get_if<std::vector<num_type>>(&column)) {
+                if (const auto number = std::get_if<num_type>(&value)) {
+                    numbers->push_back(*number);
+                    return;
+                }
+            } else if (auto texts = std::get_if<std::vector<string_type>>(&column)) {
+                if (const auto text = std::get_if<string_type>(&value)) {
+                    texts->push_back(*text);
+                    return;
+                }
+            } else {
+                std::get<std::vector<literal_value>>(column).push_back(value);
+                return;
+            }
+
+            std::vector<literal_value> mixed;
+            std::visit([&mixed](auto &values) {
+                mixed.reserve(values.size() + 1);
+                std::move(values.begin(), values.end(), std::back_inserter(mixed));
+            }, column);
+            mixed.push_back(value);
+            column = std::move(mixed);
+        }
+
+
+        /**
+         * Build one element object of a columnar array
+         */
+        shared_node build_element(std::string_view array_name, const std::vector<node_name> &shape,
+                                  const std::vector<columnar_array_node::column> &columns, size_t index,
+                                  bool frozen) {
+            auto element = make_object(fmt::format("{}[{}]", array_name, index));
+            for (size_t member = 0; member < shape.size(); member++) {
+                std::visit([&](const auto &values) {
+                    element->add_child(make_literal(shape[member], literal_value(values[index])));
+                }, columns[member]);
+            }
+            if (frozen) {
+                element->freeze();
+            }
+            return element;
+        }
+
+
+        /**
+         * Build the element objects of a columnar array
+         */
+        node_list build_elements(std::string_view array_name, const std::vector<node_name> &shape,
+                                 const std::vector<columnar_array_node::column> &columns, size_t count,
+                                 bool frozen) {
+            node_list elements;
+            elements.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                elements.push_back(build_element(array_name, shape, columns, i, frozen));
+            }
+            return elements;
+        }
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::columnar_array_node
+     *
+     ************************************************************/
+
+
+    struct columnar_array_node::column_builder {
+        std::vector<node_name> shape;
+        std::vector<column> columns;
+        size_t count = 0;
+    };
+
+
+    columnar_array_node::columnar_array_node(node_name name)
+        : array_node(std::move(name))
+    {}
+
+
+    columnar_array_node::~columnar_array_node() = default;
+
+
+    bool columnar_array_node::absorb_last() {
+        check_mutable();
+        if (rows_only || is_columnar()) {
+            return false;
+        }
+        // Absorbed elements are removed, so a uniform array only holds the new one
+        const auto &elements = get_children();
+        if (elements.size() == 1 && absorb(*elements.front())) {
+            assign_children({});
+            return true;
+        }
+        keep_rows();
+        return false;
+    }
+
+
+    bool columnar_array_node::compact(size_t min_elements) {
+        check_mutable();
+        if (is_columnar()) {
+            return true;
+        }
+        if (!rows_only) {
+            const auto &elements = get_children();
+            size_t absorbed = 0;
+            while (absorbed < elements.size() && absorb(*elements[absorbed])) {
+                absorbed++;
+            }
+            const bool uniform = absorbed == elements.size();
+            assign_children(node_list(elements.begin() + static_cast<std::ptrdiff_t>(absorbed), elements.end()));
+            if (!uniform) {
+                keep_rows();
+            }
+        }
+        if (rows_only || pending == nullptr || pending->count < min_elements) {
+            keep_rows();
+            return false;
+        }
+
+        element_count = pending->count;
+        columns.store(std::make_shared<const std::vector<column>>(std::move(pending->columns)),
+                      std::memory_order_release);
+        shape = std::make_shared<const std::vector<node_name>>(std::move(pending->shape));
+        pending.reset();
+        return true;
+    }
+
+
+    bool columnar_array_node::absorb(const node &element) {
+        const auto object = as_flat_object(element);
+        if (object == nullptr || object->get_children().empty()) {
+            return false;
+        }
+        const auto &members = object->get_children();
+        if (pending == nullptr) {
+            pending = std::make_unique<column_builder>();
+            for (size_t i = 0; i < members.size(); i++) {
+                pending->shape.push_back(members[i]->name_handle());
+                pending->columns.push_back(start_column(member_value(*object, i)));
+            }
+            pending->count = 1;
+            return true;
+        }
+
+        if (members.size() != pending->shape.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            if (members[i]->name_handle() != pending->shape[i]) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            append_value(pending->columns[i], member_value(*object, i));
+        }
+        pending->count++;
+        return true;
+    }
+
+
+    void columnar_array_node::keep_rows() {
+        rows_only = true;
+        if (pending == nullptr) {
+            return;
+        }
+        // The absorbed elements came before any element still held as a node
+        auto elements = build_elements(name(), pending->shape, pending->columns, pending->count, false);
+        const auto &rest = get_children();
+        elements.insert(elements.end(), rest.begin(), rest.end());
+        assign_children(std::move(elements));
+        pending.reset();
+    }
+
+
+    const std::vector<node_name> &columnar_array_node::get_shape() const {
+        static const std::vector<node_name> no_shape;
+        return is_columnar() ? *shape : no_shape;
+    }
+
+
+    size_t columnar_array_node::size() const {
+        return is_columnar() ? element_count : get_children().size();
+    }
+
+
+    shared_node columnar_array_node::element(size_t index) const {
+        const auto values = is_columnar() ? columns.load(std::memory_order_acquire) : nullptr;
+        if (values == nullptr) {
+            return array_node::element(index);
+        }
+        if (index >= element_count) {
+            throw no_such_element_exception(
+                fmt::format("{} {} does not contain an element at index {}", type(), name(), index));
+        }
+        return build_element(name(), *shape, *values, index, is_frozen());
+    }
+
+
+    std::shared_ptr<const columnar_array_node::column> columnar_array_node::get_column(std::string_view key) const {
+        if (!is_columnar()) {
+            return nullptr;
+        }
+        const auto values = columns.load(std::memory_order_acquire);
+        const auto found = std::find_if(shape->begin(), shape->end(),
+            [key](const node_name &name) { return name.view() == key; });
+        if (values == nullptr || found == shape->end()) {
+            return nullptr;
+        }
+        // Shares ownership of all columns, so that they outlive a concurrent materialize()
+        return {values, &(*values)[found - shape->begin()]};
+    }
+
+
+    std::shared_ptr<columnar_array_node> columnar_array_node::copy_as(node_name name) const {
+        auto copy = std::make_shared<columnar_array_node>(std::move(name));
+        if (!is_columnar()) {
+            for (const auto &child : get_children()) {
+                copy->add_child(child);
+            }
+            return copy;
+        }
+
+        const auto values = columns.load(std::memory_order_acquire);
+        if (values == nullptr) {
+            // Materialized meanwhile. The elements are flat objects, whose members can be shared.
+            const auto &elements = get_children();
+            for (size_t i = 0; i < elements.size(); i++) {
+                auto element = make_object(fmt::format("{}[{}]", copy->name(), i));
+                for (const auto &member : static_cast<const object_node &>(*elements[i]).get_children()) {
+                    element->add_child(member);
+                }
+                copy->add_child(element);
+            }
+        } else {
+            copy->shape = shape;
+            copy->columns.store(values, std::memory_order_relaxed);
+            copy->element_count = element_count;
+        }
+        return copy;
+    }
+
+
+    bool columnar_array_node::operator==(const node &other) const {
+        const auto other_columnar = dynamic_cast<const columnar_array_node *>(&other);
+        if (other_columnar == nullptr || !is_columnar() || !other_columnar->is_columnar()) {
+            return array_node::operator==(other);
+        }
+        const auto values = columns.load(std::memory_order_acquire);
+        const auto other_values = other_columnar->columns.load(std::memory_order_acquire);
+        if (values == nullptr || other_values == nullptr) {
+            return array_node::operator==(other);
+        }
+        return name_handle() == other_columnar->name_handle()
+            && element_count == other_columnar->element_count
+            && *shape == *other_columnar->shape
+            && *values == *other_values;
+    }
+
+
+    void columnar_array_node::freeze() {
+        if (is_materialized()) {
+            array_node::freeze();
+        } else {
+            node::freeze();
+        }
+    }
+
+
+    std::uint64_t columnar_array_node::compute_hash() const {
+        const auto values = is_columnar() ? columns.load(std::memory_order_acquire) : nullptr;
+        if (values == nullptr) {
+            return array_node::compute_hash();
+        }
+        auto seed = array_hash_seed;
+        std::string element_name;
+        for (size_t i = 0; i < element_count; i++) {
+            auto element = object_hash_seed;
+            for (size_t member = 0; member < shape->size(); member++) {
+                const auto value = std::visit([i](const auto &column) { return hash_literal(column[i]); }, (*values)[member]);
+                element = combine_hash(element, named_hash((*shape)[member].view(), value));
+            }
+            element_name.clear();
+            fmt::format_to(std::back_inserter(element_name), "{}[{}]", name(), i);
+            seed = combine_hash(seed, named_hash(element_name, element));
+        }
+        return seed;
+    }
+
+
+    void columnar_array_node::materialize() const {
+        if (!is_columnar()) {
+            return;
+        }
+        std::call_once(once, [this] {
+            const auto values = columns.load(std::memory_order_acquire);
+            assign_children(build_elements(name(), *shape, *values, element_count, is_frozen()));
+            materialized.store(true, std::memory_order_release);
+            // Readers which still hold the columns keep them alive until they are done
+            columns.store(nullptr, std::memory_order_release);
+        });
+    }
+
+}
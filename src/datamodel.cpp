@@ -1,9 +1,17 @@
 
+#include <array>
+#include <bit>
+#include <charconv>
 #include <cmath>
+#include <limits>
+#include <random>
 #include <vole/datamodel.hpp>
 
 #include <regex>
+#include <mutex>
+#include <shared_mutex>
 #include <type_traits>
+#include <unordered_set>
 #include <fmt/format.h>
 
 #include <vole/exception.hpp>
@@ -16,6 +24,183 @@ using namespace std::string_literals;
 
 namespace vole::datamodel {
 
+    /************************************************************
+     *
+     *                  vole::datamodel::node_name
+     *
+     ************************************************************/
+
+
+    /**
+     * The texts of one name_pool. Interned names point into it and keep it
+     * alive, so it outlives the pool when they do.
+     */
+    struct node_name::name_table {
+        struct text_hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view text) const {
+                return std::hash<std::string_view>{}(text);
+            }
+        };
+
+        mutable std::shared_mutex mutex;
+        // Nodes of an unordered_set stay put, so names may point at the texts
+        std::unordered_set<std::string, text_hash, std::equal_to<>> texts;
+    };
+
+
+    node_name::node_name(std::string text) {
+        if (text.size() <= inline_capacity) {
+            inline_text short_name{};
+            std::copy(text.begin(), text.end(), short_name.chars.begin());
+            short_name.size = static_cast<std::uint8_t>(text.size());
+            storage = short_name;
+        } else {
+            storage = std::make_shared<const std::string>(std::move(text));
+        }
+    }
+
+
+    node_name::node_name(const char *text)
+        : node_name(std::string(text))
+    {}
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::name_pool
+     *
+     ************************************************************/
+
+
+    name_pool::name_pool()
+        : table(std::make_shared<node_name::name_table>())
+    {}
+
+
+    node_name name_pool::intern(std::string_view text) {
+        {
+            std::shared_lock lock(table->mutex);
+            if (const auto existing = table->texts.find(text); existing != table->texts.end()) {
+                return node_name(node_name::pooled_text{table, &*existing});
+            }
+        }
+        std::unique_lock lock(table->mutex);
+        const auto stored = table->texts.emplace(text).first;
+        return node_name(node_name::pooled_text{table, &*stored});
+    }
+
+
+    size_t name_pool::size() const {
+        std::shared_lock lock(table->mutex);
+        return table->texts.size();
+    }
+
+
+    namespace {
+
+        /**
+         * The key of the subtree hashes, drawn once per process. Keying the
+         * hash keeps crafted inputs from colliding on purpose, so that equal
+         * hashes can be taken as equal subtrees.
+         */
+        const std::array<std::uint64_t, 2> &hash_key() {
+            static const auto key = [] {
+                std::random_device device;
+                const auto word = [&device] {
+                    return (static_cast<std::uint64_t>(device()) << 32) | device();
+                };
+                return std::array<std::uint64_t, 2>{word(), word()};
+            }();
+            return key;
+        }
+
+
+        /**
+         * SipHash-2-4 of a byte range under hash_key()
+         */
+        std::uint64_t keyed_hash(const void *data, size_t size) {
+            const auto &[k0, k1] = hash_key();
+            std::uint64_t v0 = k0 ^ 0x736f6d6570736575;
+            std::uint64_t v1 = k1 ^ 0x646f72616e646f6d;
+            std::uint64_t v2 = k0 ^ 0x6c7967656e657261;
+            std::uint64_t v3 = k1 ^ 0x7465646279746573;
+            const auto round = [&] {
+                v0 += v1; v1 = std::rotl(v1, 13); v1 ^= v0; v0 = std::rotl(v0, 32);
+                v2 += v3; v3 = std::rotl(v3, 16); v3 ^= v2;
+                v0 += v3; v3 = std::rotl(v3, 21); v3 ^= v0;
+                v2 += v1; v1 = std::rotl(v1, 17); v1 ^= v2; v2 = std::rotl(v2, 32);
+            };
+            const auto compress = [&](std::uint64_t word) {
+                v3 ^= word;
+                round();
+                round();
+                v0 ^= word;
+            };
+
+            const auto bytes = static_cast<const unsigned char *>(data);
+            const auto full = size - size % 8;
+            for (size_t offset = 0; offset < full; offset += 8) {
+                std::uint64_t word = 0;
+                for (size_t i = 0; i < 8; i++) {
+                    word |= static_cast<std::uint64_t>(bytes[offset + i]) << (8 * i);
+                }
+                compress(word);
+            }
+            std::uint64_t last = static_cast<std::uint64_t>(size) << 56;
+            for (size_t i = 0; i < size % 8; i++) {
+                last |= static_cast<std::uint64_t>(bytes[full + i]) << (8 * i);
+            }
+            compress(last);
+
+            v2 ^= 0xff;
+            for (int i = 0; i < 4; i++) {
+                round();
+            }
+            return v0 ^ v1 ^ v2 ^ v3;
+        }
+
+
+        std::uint64_t keyed_hash(std::string_view text) {
+            return keyed_hash(text.data(), text.size());
+        }
+
+
+        /**
+         * Fold a value into a running hash by hashing both under the key
+         */
+        std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value) {
+            const std::array<std::uint64_t, 2> words{seed, value};
+            return keyed_hash(words.data(), sizeof(words));
+        }
+
+
+        struct literal_hasher {
+            std::uint64_t operator()(const null_type&) {return 0;}
+            std::uint64_t operator()(const string_type& s) {return keyed_hash(s);}
+            std::uint64_t operator()(const bool_type& b) {return b ? 1 : 2;}
+            std::uint64_t operator()(const num_type& n) {
+                // Zero and negative zero compare equal, so they have to hash equally
+                return std::bit_cast<std::uint64_t>(n == 0.0 ? 0.0 : n);
+            }
+            std::uint64_t operator()(const binary_type& b) {
+                return keyed_hash(b.data(), b.size());
+            }
+        };
+
+
+        template <typename T, size_t I = 0>
+        constexpr size_t alternative_index() {
+            if constexpr (std::is_same_v<std::variant_alternative_t<I, literal_value>, T>) {
+                return I;
+            } else {
+                return alternative_index<T, I + 1>();
+            }
+        }
+
+    }
+
+
     /************************************************************
      * 
      *                  vole::datamodel::node
@@ -33,6 +218,45 @@ namespace vole::datamodel {
     }
 
 
+    void node::freeze() {
+        frozen = true;
+    }
+
+
+    std::uint64_t node::subtree_hash() const {
+        if (const auto cached = cached_hash.load(std::memory_order_relaxed); cached != 0) {
+            return cached;
+        }
+        const auto hash = named_hash(name(), compute_hash());
+        if (frozen) {
+            // Racing threads compute the same value, so either store wins
+            cached_hash.store(hash, std::memory_order_relaxed);
+        }
+        return hash;
+    }
+
+
+    std::uint64_t node::combine_hash(std::uint64_t seed, std::uint64_t value) {
+        return hash_combine(seed, value);
+    }
+
+
+    std::uint64_t node::named_hash(std::string_view name, std::uint64_t content) {
+        const auto hash = combine_hash(keyed_hash(name), content);
+        // Zero marks a hash which has not been computed yet
+        return hash == 0 ? 1 : hash;
+    }
+
+
+    void node::check_mutable() const {
+        if (frozen) {
+            throw invalid_operation_exception(
+                fmt::format("{} {} is frozen and cannot be modified", type(), name())
+            );
+        }
+    }
+
+
     /************************************************************
      * 
      *                  vole::datamodel::array_node
@@ -46,6 +270,7 @@ namespace vole::datamodel {
 
 
     shared_node array_node::get_child(size_t index) const {
+        materialize();
         try {
             return children.at(index);
         } catch (std::out_of_range) {
@@ -57,6 +282,16 @@ namespace vole::datamodel {
     }
 
 
+    size_t array_node::size() const {
+        return get_children().size();
+    }
+
+
+    shared_node array_node::element(size_t index) const {
+        return get_child(index);
+    }
+
+
     void array_node::apply(const_node_visitor &visitor) const {
         visitor.visit(*this);
     }
@@ -68,14 +303,22 @@ namespace vole::datamodel {
 
 
     void array_node::add_child(shared_node newChild) {
+        check_mutable();
+        materialize();
         children.push_back(std::move(newChild));
     }
 
 
     const node_list& array_node::get_children() const {
+        materialize();
         return children;
     }
 
+
+    void array_node::assign_children(node_list nodes) const {
+        children = std::move(nodes);
+    }
+
     bool array_node::operator==(const node &other) const {
         const auto other_array = dynamic_cast<const array_node*>(&other);
         if (other_array == nullptr) {
@@ -83,16 +326,18 @@ namespace vole::datamodel {
             return false;
         }
 
-        if (this->name() != other_array->name()) {
+        if (this->name_handle() != other_array->name_handle()) {
             return false;
         }
 
-        if (this->children.size() != other_array->children.size()) {
+        const auto &children = get_children();
+        const auto &other_children = other_array->get_children();
+        if (children.size() != other_children.size()) {
             return false;
         }
 
-        for (size_t i = 0; i < this->children.size(); i++) {
-            if (*this->children[i] != *other_array->children[i]) {
+        for (size_t i = 0; i < children.size(); i++) {
+            if (*children[i] != *other_children[i]) {
                 return false;
             }
         }
@@ -101,6 +346,27 @@ namespace vole::datamodel {
     }
 
 
+    std::uint64_t array_node::compute_hash() const {
+        auto seed = array_hash_seed;
+        for (const auto &child : get_children()) {
+            seed = combine_hash(seed, child->subtree_hash());
+        }
+        return seed;
+    }
+
+
+    void array_node::freeze() {
+        node::freeze();
+        children.shrink_to_fit();
+        for (const auto &child : children) {
+            // Subtrees shared with other documents are frozen already, and must not be written to
+            if (!child->is_frozen()) {
+                child->freeze();
+            }
+        }
+    }
+
+
     /************************************************************
      * 
      *                  vole::datamodel::literal_node
@@ -114,6 +380,7 @@ namespace vole::datamodel {
             std::string operator()(const string_type& s) {return "string";}
             std::string operator()(const bool_type& b) {return "bool";}
             std::string operator()(const num_type& n) {return "num";}
+            std::string operator()(const binary_type& b) {return "binary";}
         } renderer;
         return std::visit(renderer, value);
     }
@@ -122,7 +389,37 @@ namespace vole::datamodel {
         return b ? "true" : "false";
     }
 
+    void append_integer(std::string &output, std::int64_t value) {
+        char buffer[std::numeric_limits<std::int64_t>::digits10 + 2];
+        const auto end = std::to_chars(std::begin(buffer), std::end(buffer), value).ptr;
+        output.append(buffer, end);
+    }
+
+    std::uint64_t hash_literal(const literal_value &value) {
+        return hash_combine(value.index(), std::visit(literal_hasher{}, value));
+    }
+
+    std::uint64_t hash_literal(num_type value) {
+        return hash_combine(alternative_index<num_type>(), literal_hasher{}(value));
+    }
+
+    std::uint64_t hash_literal(const string_type &value) {
+        return hash_combine(alternative_index<string_type>(), literal_hasher{}(value));
+    }
+
+    std::uint64_t keyed_digest(std::string_view data) {
+        return keyed_hash(data);
+    }
+
     std::string render_int(num_type i) {
+        // Integers which fit into 64 bits take the to_chars fast path. Negative
+        // zero goes through fmt as well so that it keeps its sign.
+        constexpr num_type int64_limit = 9.2e18;
+        if (std::abs(i) < int64_limit && !(i == 0.0 && std::signbit(i))) {
+            std::string text;
+            append_integer(text, static_cast<std::int64_t>(i));
+            return text;
+        }
         // if it's an integer, don't display zeroes
         return fmt::format("{:.0f}", i);
     }
@@ -139,12 +436,25 @@ namespace vole::datamodel {
         return render_real(n);
     }
 
+    std::string render_binary(const binary_type &b) {
+        // Render as lowercase hex, two characters per byte
+        constexpr std::string_view digits = "0123456789abcdef";
+        std::string text;
+        text.reserve(b.size() * 2);
+        for (const auto byte : b) {
+            text.push_back(digits[byte >> 4]);
+            text.push_back(digits[byte & 0x0f]);
+        }
+        return text;
+    }
+
     std::string literal_node::render() const {
         struct printer_t {
             std::string operator()(const null_type&) {return "null";}
             std::string operator()(const string_type& s) {return s;}
             std::string operator()(const bool_type& b) {return render_bool(b);}
             std::string operator()(const num_type& n) {return render_num(n);}
+            std::string operator()(const binary_type& b) {return render_binary(b);}
         } renderer;
         return std::visit<std::string>(renderer, value);
     }
@@ -166,7 +476,7 @@ namespace vole::datamodel {
             return false;
         }
 
-        if (this->name() != other_literal->name()) {
+        if (this->name_handle() != other_literal->name_handle()) {
             return false;
         }
 
@@ -178,6 +488,11 @@ namespace vole::datamodel {
     }
 
 
+    std::uint64_t literal_node::compute_hash() const {
+        return hash_literal(value);
+    }
+
+
     /************************************************************
      * 
      *                  vole::datamodel::object_node
@@ -186,6 +501,8 @@ namespace vole::datamodel {
 
 
     shared_node object_node::get_child(std::string_view name) const {
+        materialize();
+        // Compares the text, so that readers of frozen trees never touch a pool
         auto childItr = std::find_if(children.begin(), children.end(),
             [name](const auto &child){return child->name() == name;});
 
@@ -200,14 +517,32 @@ namespace vole::datamodel {
     }
 
 
+    shared_node object_node::get_child(const node_name &name) const {
+        materialize();
+        auto childItr = std::find_if(children.begin(), children.end(),
+            [&name](const auto &child){return child->name_handle() == name;});
+
+        if (childItr == children.end()) {
+            throw no_such_element_exception(
+                fmt::format("{} {} does not contain an element with name {}",
+                    type(), this->name(), name.view())
+            );
+        }
+
+        return *childItr;
+    }
+
+
     std::string object_node::type() const {
         return "object_node";
     }
 
 
     void object_node::add_child(shared_node newChild) {
+        check_mutable();
+        materialize();
         auto existingChildItr = std::find_if(children.begin(), children.end(),
-            [&newChild](const auto &child){return child->name() == newChild->name();});
+            [&newChild](const auto &child){return child->name_handle() == newChild->name_handle();});
         
         if (existingChildItr != children.end()) {
             throw duplicate_key_exception(
@@ -223,10 +558,16 @@ namespace vole::datamodel {
 
 
     const node_list& object_node::get_children() const {
+        materialize();
         return children;
     }
 
 
+    void object_node::assign_children(node_list nodes) const {
+        children = std::move(nodes);
+    }
+
+
     void object_node::apply(const_node_visitor &visitor) const {
         visitor.visit(*this);
     }
@@ -244,16 +585,18 @@ namespace vole::datamodel {
             return false;
         }
 
-        if (this->name() != other_object->name()) {
+        if (this->name_handle() != other_object->name_handle()) {
             return false;
         }
 
-        if (this->children.size() != other_object->children.size()) {
+        const auto &children = get_children();
+        const auto &other_children = other_object->get_children();
+        if (children.size() != other_children.size()) {
             return false;
         }
 
-        for (size_t i = 0; i < this->children.size(); i++) {
-            if (*this->children[i] != *other_object->children[i]) {
+        for (size_t i = 0; i < children.size(); i++) {
+            if (*children[i] != *other_children[i]) {
                 return false;
             }
         }
@@ -262,6 +605,48 @@ namespace vole::datamodel {
     }
 
 
+    std::uint64_t object_node::compute_hash() const {
+        auto seed = object_hash_seed;
+        for (const auto &child : get_children()) {
+            seed = combine_hash(seed, child->subtree_hash());
+        }
+        return seed;
+    }
+
+
+    void object_node::freeze() {
+        node::freeze();
+        children.shrink_to_fit();
+        for (const auto &child : children) {
+            // Subtrees shared with other documents are frozen already, and must not be written to
+            if (!child->is_frozen()) {
+                child->freeze();
+            }
+        }
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::frozen_document
+     *
+     ************************************************************/
+
+
+    frozen_document::frozen_document(shared_node root) {
+        if (root == nullptr) {
+            throw invalid_operation_exception("Unable to freeze an empty node tree");
+        }
+        root->freeze();
+        root_node = std::move(root);
+    }
+
+
+    frozen_document freeze(shared_node root) {
+        return frozen_document(std::move(root));
+    }
+
+
     /************************************************************
      *
      *                  vole::datamodel::lambda_node_visitor
@@ -334,8 +719,9 @@ namespace vole::datamodel {
     void node_descender::visit(const array_node &node) {
         on_enter(node);
         depth++;
-        for (const auto &child : node.get_children()) {
-            child->apply(*this);
+        // One element at a time, so columnar arrays are not built as a whole
+        for (size_t i = 0, count = node.size(); i < count; i++) {
+            node.element(i)->apply(*this);
         }
         depth--;
         on_exit(node);
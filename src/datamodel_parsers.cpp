@@ -6,109 +6,441 @@
 #include <nlohmann/json.hpp>
 #include <fmt/format.h>
 
+#include "vole/columnar_array.hpp"
 #include "vole/exception.hpp"
 
 namespace vole::datamodel {
 
     class json_sax_listener : public nlohmann::json_sax<nlohmann::json> {
     public:
+        /**
+         * @param projection If given, only the parts of the document selected
+         *        by the projection are turned into nodes. Must outlive the listener.
+         * @param limits The resources the document may take
+         */
+        explicit json_sax_listener(const path_projection *projection = nullptr, const parse_limits &limits = {})
+            : projection(projection), limits(limits) {}
 
         shared_node get_built_node() {
             return builder.get_root();
         }
 
-        bool binary(binary_t &) override {
-            throw unsupported_element_exception("Binary data is not supported");
+        bool binary(binary_t &val) override {
+            const bool built = enter_value();
+            check_length(val.size());
+            if (built) {
+                charge(sizeof(literal_node) + val.size());
+                binary_type bytes = std::move(static_cast<binary_t::container_type &>(val));
+                builder.add_child(make_literal(gen_node_name("Binary"), std::move(bytes)));
+            }
+            return true;
         }
 
-        bool boolean(bool) override {
-            builder.add_child(make_literal(gen_node_name("Boolean"), true));
+        bool boolean(bool val) override {
+            if (enter_value()) {
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Boolean"), val));
+            }
             return true;
         }
 
         bool start_array(size_t) override {
-            builder.add_child(make_array(gen_node_name("Array")));
+            const bool built = enter_value();
+            check_depth();
+            if (!built) {
+                skip_depth++;
+                return true;
+            }
+            charge(sizeof(columnar_array_node));
+            // Arrays of uniform records take over each element as it is completed
+            auto array = std::make_shared<columnar_array_node>(gen_node_name("Array"));
+            push_frame(true, array->name());
+            builder.add_child(array);
             return true;
         }
 
         bool end_array() override {
-            builder.close_parent();
-            return true;
+            if (skip_depth == 0) {
+                static_cast<columnar_array_node &>(*builder.last_parent()).compact();
+            }
+            return leave_container();
         }
 
         bool start_object(size_t elements) override {
-            builder.add_child(make_object(gen_node_name("Object")));
+            const bool built = enter_value();
+            check_depth();
+            if (!built) {
+                skip_depth++;
+                return true;
+            }
+            charge(sizeof(object_node));
+            auto object = make_object(gen_node_name("Object"));
+            push_frame(false, object->name());
+            builder.add_child(object);
             return true;
         }
 
         bool end_object() override {
-            builder.close_parent();
+            const bool element = skip_depth == 0 && frames.size() >= 2 && frames[frames.size() - 2].is_array;
+            leave_container();
+            if (element) {
+                static_cast<columnar_array_node &>(*builder.last_parent()).absorb_last();
+            }
             return true;
         }
 
         bool key(string_t &key) override {
-            // Save the key to use in object naming later
-            last_key = key;
+            // Located at the object, as the key itself is too long to show
+            check_length(key.size(), false);
+            if (skip_depth == 0) {
+                // Save the key to use in object naming later
+                last_key = names.intern(key);
+            }
             return true;
         }
 
         bool null() override {
-            builder.add_child(make_literal(gen_node_name("Null"), nullptr));
+            if (enter_value()) {
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Null"), nullptr));
+            }
             return true;
         }
 
         bool number_integer(number_integer_t val) override {
-            builder.add_child(make_literal(gen_node_name("Number"), static_cast<double>(val)));
+            if (enter_value()) {
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Number"), static_cast<double>(val)));
+            }
             return true;
         }
 
         bool number_unsigned(number_unsigned_t val) override {
-            builder.add_child(make_literal(gen_node_name("Number"), static_cast<double>(val)));
+            if (enter_value()) {
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Number"), static_cast<double>(val)));
+            }
             return true;
         }
 
         bool number_float(number_float_t val, const string_t &s) override {
-            builder.add_child(make_literal(gen_node_name("Number"), val));
+            if (enter_value()) {
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Number"), val));
+            }
             return true;
         }
 
         bool string(string_t &val) override {
-            builder.add_child(make_literal(gen_node_name("String"), val));
+            const bool built = enter_value();
+            check_length(val.size());
+            if (built) {
+                charge(sizeof(literal_node) + val.size());
+                builder.add_child(make_literal(gen_node_name("String"), val));
+            }
             return true;
         }
 
         bool parse_error(std::size_t location,
                          const std::string &token,
                          const nlohmann::detail::exception& e) override {
-            throw unsupported_element_exception("Errors are not supported");
+            throw syntax_exception(fmt::format("Invalid model at offset {}: {}", location, e.what()));
         }
 
-        std::string gen_node_name(std::string_view type) {
+        node_name gen_node_name(std::string_view type) {
             if (last_key.has_value()) {
-                const std::string name = last_key.value();
+                node_name name = std::move(last_key.value());
                 last_key.reset();
                 return name;
             }
-            // Last parent was an array, number it!
-            if (auto last_array = std::dynamic_pointer_cast<array_node>(builder.last_parent())) {
-                auto length = last_array->get_children().size();
-                return fmt::format("{}[{}]", last_array->name(), length);
+            // Last parent was an array, number it! Element names are unique, so pooling them saves nothing
+            if (pending_index.has_value()) {
+                return fmt::format("{}[{}]", builder.last_parent()->name(), pending_index.value());
             }
             return fmt::format("Unnamed{}{}", type, unnamed_object_count++);
         }
     private:
+        struct container_frame {
+            bool is_array;
+            size_t next_index;
+            path_projection::selection selection;
+            // How the container is addressed from its parent, e.g. `.name` or `[2]`
+            std::string segment;
+        };
+
+        // Besides the node itself, its shared_ptr control block and its slot in the parent
+        static constexpr size_t node_overhead = 2 * sizeof(void *) + sizeof(shared_node);
+
+        void push_frame(bool is_array, std::string_view name) {
+            std::string segment = frames.empty() ? std::string(name)
+                : pending_index.has_value() ? fmt::format("[{}]", pending_index.value())
+                : fmt::format(".{}", name);
+            frames.push_back({is_array, 0, std::move(pending_selection), std::move(segment)});
+        }
+
+        /**
+         * @param entered Whether enter_value() was called for the value being reported
+         * @return The path of the value being reported, e.g. `RootNode.items[3].name`,
+         *         or of its container if it was not entered yet
+         */
+        std::string location(bool entered = true) const {
+            std::string path;
+            for (const auto &frame : frames) {
+                path += frame.segment;
+            }
+            if (!entered || skip_depth > 0) {
+                // Values below skipped containers are located at the innermost container which is built
+                return path;
+            }
+            if (frames.empty()) {
+                return last_key.has_value() ? std::string(last_key->view()) : path;
+            }
+            if (frames.back().is_array && pending_index.has_value()) {
+                path += fmt::format("[{}]", pending_index.value());
+            } else if (!frames.back().is_array && last_key.has_value()) {
+                path += fmt::format(".{}", last_key->view());
+            }
+            return path;
+        }
+
+        void check_depth() const {
+            if (frames.size() + skip_depth >= limits.max_depth) {
+                throw limit_exceeded_exception(fmt::format(
+                    "Model exceeds the maximum depth of {} at {}", limits.max_depth, location()));
+            }
+        }
+
+        /**
+         * Reject a string, key or binary which is too long. nlohmann hands
+         * values over only once it has buffered them whole, so this keeps
+         * them out of the tree but does not cap the memory of reading them.
+         */
+        void check_length(size_t length, bool entered = true) const {
+            if (length > limits.max_string_length) {
+                throw limit_exceeded_exception(fmt::format(
+                    "Model contains a value of {} bytes, more than the maximum of {}, at {}",
+                    length, limits.max_string_length, location(entered)));
+            }
+        }
+
+        /**
+         * Account for a node which is about to be built
+         * @param bytes The size of the node and of the data it owns
+         */
+        void charge(size_t bytes) {
+            if (++node_count > limits.max_nodes) {
+                throw limit_exceeded_exception(fmt::format(
+                    "Model exceeds the maximum of {} nodes at {}", limits.max_nodes, location()));
+            }
+            used_bytes += bytes + node_overhead;
+            if (used_bytes > limits.max_bytes) {
+                throw limit_exceeded_exception(fmt::format(
+                    "Model exceeds the budget of {} bytes at {}", limits.max_bytes, location()));
+            }
+        }
+
+        /**
+         * Prepare the name and projection of the value which is about to be
+         * reported, and decide whether it should be turned into a node.
+         * @return false if the value lies outside the projection and must be skipped
+         */
+        bool enter_value() {
+            if (skip_depth > 0) {
+                return false;
+            }
+            pending_index.reset();
+            if (frames.empty()) {
+                if (projection != nullptr) {
+                    pending_selection = projection->root();
+                }
+                return true;
+            }
+
+            auto &parent = frames.back();
+            if (parent.is_array) {
+                pending_index = parent.next_index++;
+            }
+            if (projection == nullptr) {
+                return true;
+            }
+
+            pending_selection = parent.is_array
+                ? projection->select_element(parent.selection, pending_index.value())
+                : projection->select_member(parent.selection, last_key.has_value() ? last_key->view() : "");
+            if (!pending_selection.empty()) {
+                return true;
+            }
+
+            if (parent.is_array && projection->selects_later_element(parent.selection, pending_index.value())) {
+                // Keep a placeholder so that the requested elements retain their index.
+                // Placeholders are nodes like any other, so they count against the limits.
+                charge(sizeof(literal_node));
+                builder.add_child(make_literal(gen_node_name("Null"), nullptr));
+            }
+            last_key.reset();
+            return false;
+        }
+
+        bool leave_container() {
+            if (skip_depth > 0) {
+                skip_depth--;
+                return true;
+            }
+            frames.pop_back();
+            builder.close_parent();
+            return true;
+        }
+
         node_tree_builder builder;
-        std::optional<std::string> last_key = "RootNode";
+        name_pool names;
+        const path_projection *projection;
+        const parse_limits limits;
+        size_t node_count = 0;
+        size_t used_bytes = 0;
+        std::vector<container_frame> frames;
+        path_projection::selection pending_selection;
+        std::optional<size_t> pending_index;
+        size_t skip_depth = 0;
+        std::optional<node_name> last_key = "RootNode";
         size_t unnamed_object_count = 0;
     };
 
-    shared_node json_parser::parse(std::string_view input) {
-        json_sax_listener listener;
-        nlohmann::json::sax_parse(input, &listener);
+
+    static shared_node sax_parse(std::string_view input,
+                                 nlohmann::json::input_format_t format,
+                                 const std::optional<path_projection> &projection,
+                                 const parse_limits &limits) {
+        json_sax_listener listener(projection.has_value() ? &projection.value() : nullptr, limits);
+        nlohmann::json::sax_parse(input, &listener, format);
         return listener.get_built_node();
     }
 
 
+    /************************************************************
+     *
+     *                  vole::datamodel::json_parser
+     *
+     ************************************************************/
+
+
+    json_parser::json_parser() = default;
+
+
+    json_parser::json_parser(path_projection projection)
+        : projection(std::move(projection))
+    {}
+
+
+    shared_node json_parser::parse(std::string_view input) {
+        return sax_parse(input, nlohmann::json::input_format_t::json, projection, limits);
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::cbor_parser
+     *
+     ************************************************************/
+
+
+    cbor_parser::cbor_parser() = default;
+
+
+    cbor_parser::cbor_parser(path_projection projection)
+        : projection(std::move(projection))
+    {}
+
+
+    shared_node cbor_parser::parse(std::string_view input) {
+        return sax_parse(input, nlohmann::json::input_format_t::cbor, projection, limits);
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::msgpack_parser
+     *
+     ************************************************************/
+
+
+    msgpack_parser::msgpack_parser() = default;
+
+
+    msgpack_parser::msgpack_parser(path_projection projection)
+        : projection(std::move(projection))
+    {}
+
+
+    shared_node msgpack_parser::parse(std::string_view input) {
+        return sax_parse(input, nlohmann::json::input_format_t::msgpack, projection, limits);
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::model_format
+     *
+     ************************************************************/
+
+
+    model_format format_from_path(const std::filesystem::path &path) {
+        const auto extension = path.extension();
+        if (extension == ".cbor") {
+            return model_format::cbor;
+        }
+        if (extension == ".msgpack" || extension == ".mpk") {
+            return model_format::msgpack;
+        }
+        return model_format::json;
+    }
+
+
+    model_format format_from_name(std::string_view name) {
+        if (name == "json") {
+            return model_format::json;
+        }
+        if (name == "cbor") {
+            return model_format::cbor;
+        }
+        if (name == "msgpack") {
+            return model_format::msgpack;
+        }
+        throw unsupported_element_exception(fmt::format("Unknown model format '{}'", name));
+    }
+
+
+    std::string_view format_name(model_format format) {
+        switch (format) {
+        case model_format::cbor:
+            return "cbor";
+        case model_format::msgpack:
+            return "msgpack";
+        case model_format::json:
+        default:
+            return "json";
+        }
+    }
+
+
+    std::unique_ptr<parser> make_parser(model_format format, const parse_limits &limits) {
+        std::unique_ptr<parser> result;
+        switch (format) {
+        case model_format::cbor:
+            result = std::make_unique<cbor_parser>();
+            break;
+        case model_format::msgpack:
+            result = std::make_unique<msgpack_parser>();
+            break;
+        case model_format::json:
+        default:
+            result = std::make_unique<json_parser>();
+            break;
+        }
+        result->set_limits(limits);
+        return result;
+    }
+
+
     /************************************************************
      *
      *                  vole::datamodel::node_tree_builder
@@ -90,4 +90,38 @@ namespace vole {
     }
 
 
+    /************************************************************
+     *
+     *            syntax_exception
+     *
+     ************************************************************/
+
+
+    syntax_exception::syntax_exception(std::string text)
+        : exception(std::move(text))
+    {}
+
+
+    std::string_view syntax_exception::type() const noexcept(true) {
+        return "syntax_exception";
+    }
+
+
+    /************************************************************
+     *
+     *            limit_exceeded_exception
+     *
+     ************************************************************/
+
+
+    limit_exceeded_exception::limit_exceeded_exception(std::string text)
+        : exception(std::move(text))
+    {}
+
+
+    std::string_view limit_exceeded_exception::type() const noexcept(true) {
+        return "limit_exceeded_exception";
+    }
+
+
 }
@@ -0,0 +1,199 @@
+#include "vole/filters.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+#include "vole/node_printer.hpp"
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    namespace {
+
+        // ASCII only, independent of the locale
+        char upper_case(char c) {
+            return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+        }
+
+
+        char lower_case(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+
+        /**
+         * Maps every character through a function, in fixed-size pieces
+         */
+        template <char (*Map)(char)>
+        class character_filter : public filter_stage {
+        public:
+            using filter_stage::filter_stage;
+            using output_sink::write;
+
+            void write(std::string_view text) override {
+                std::array<char, 256> mapped;
+                while (!text.empty()) {
+                    const auto piece = text.substr(0, mapped.size());
+                    std::transform(piece.begin(), piece.end(), mapped.begin(), Map);
+                    next.write(std::string_view(mapped.data(), piece.size()));
+                    text.remove_prefix(piece.size());
+                }
+            }
+        };
+
+
+        std::string_view trim(std::string_view text) {
+            const auto first = text.find_first_not_of(' ');
+            if (first == std::string_view::npos) {
+                return {};
+            }
+            return text.substr(first, text.find_last_not_of(' ') - first + 1);
+        }
+
+
+        /**
+         * A vector kept per thread between render sections, so that
+         * rendering a section allocates nothing for it once it has grown.
+         * Taken out while in use, so nested renders do not share it.
+         */
+        template <typename T>
+        class scratch_vector {
+        public:
+            scratch_vector()
+                : items(std::exchange(spare(), {})) {}
+
+            ~scratch_vector() {
+                items.clear();
+                spare() = std::move(items);
+            }
+
+            scratch_vector(const scratch_vector &) = delete;
+            scratch_vector &operator=(const scratch_vector &) = delete;
+
+            std::vector<T> &operator*() {
+                return items;
+            }
+
+            std::vector<T> *operator->() {
+                return &items;
+            }
+
+        private:
+            static std::vector<T> &spare() {
+                thread_local std::vector<T> vector;
+                return vector;
+            }
+
+            std::vector<T> items;
+        };
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::filter_registry
+     *
+     ************************************************************/
+
+
+    filter_registry::filter_registry() {
+        add("upper", [](output_sink &next) { return std::make_unique<character_filter<upper_case>>(next); });
+        add("lower", [](output_sink &next) { return std::make_unique<character_filter<lower_case>>(next); });
+    }
+
+
+    void filter_registry::add(std::string name, factory create) {
+        filters.insert_or_assign(std::move(name), std::move(create));
+    }
+
+
+    std::unique_ptr<filter_stage> filter_registry::create(std::string_view name, output_sink &next) const {
+        const auto filter = filters.find(name);
+        if (filter == filters.end()) {
+            throw no_such_element_exception(fmt::format("No filter named {} exists", name));
+        }
+        return filter->second(next);
+    }
+
+
+    const filter_registry &filter_registry::builtin() {
+        static const filter_registry registry;
+        return registry;
+    }
+
+
+    /************************************************************
+     *
+     *                  render sections
+     *
+     ************************************************************/
+
+
+    namespace {
+
+        void render_section(const scope_frame &scope, std::string_view expression, output_sink &sink,
+                            const filter_registry &filters) {
+            scratch_vector<std::string_view> parts;
+            for (size_t start = 0; start <= expression.size(); ) {
+                const auto end = std::min(expression.find('|', start), expression.size());
+                parts->push_back(trim(expression.substr(start, end - start)));
+                start = end + 1;
+            }
+
+            const bool dump = parts->size() > 1 && (*parts)[1] == "dump";
+            const size_t first_filter = dump ? 2 : 1;
+            for (size_t i = 0; i < parts->size(); i++) {
+                if ((*parts)[i].empty()) {
+                    throw syntax_exception(fmt::format("Missing variable or filter name in '{}'", expression));
+                }
+                if (i >= first_filter && (*parts)[i] == "dump") {
+                    throw syntax_exception(fmt::format("dump must be the first filter in '{}'", expression));
+                }
+            }
+
+            const auto value = scope.resolve((*parts)[0]);
+
+            // Stack the stages from the sink upwards, so the first filter is written to first
+            scratch_vector<std::unique_ptr<filter_stage>> stages;
+            output_sink *head = &sink;
+            for (auto i = parts->size(); i-- > first_filter; ) {
+                stages->push_back(filters.create((*parts)[i], *head));
+                head = stages->back().get();
+            }
+
+            const auto node = std::get_if<const datamodel::node *>(&value);
+            if (dump && node != nullptr) {
+                node_printer printer;
+                printer.render(**node, *head);
+            } else {
+                write_rendered(value, *head);
+            }
+            // Stages may hold back text. Drained from the first filter down, so each
+            // passes on what the one above released; the sink is left to the caller.
+            for (auto stage = stages->rbegin(); stage != stages->rend(); ++stage) {
+                (*stage)->drain();
+            }
+        }
+
+    }
+
+
+    void render_expression(const scope_frame &scope, std::string_view expression, output_sink &sink,
+                           const filter_registry &filters) {
+        VOLE_PROFILE_ZONE("render section");
+        render_section(scope, expression, sink, filters);
+    }
+
+
+    void render_expression(const scope_frame &scope, std::string_view expression, const template_location &where,
+                           output_sink &sink, const filter_registry &filters) {
+        VOLE_PROFILE_TEMPLATE_ZONE("render section", where.file, where.offset);
+        render_section(scope, expression, sink, filters);
+    }
+
+}
@@ -0,0 +1,554 @@
+#include "vole/datamodel_parsers.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <limits>
+#include <mutex>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+
+namespace vole::datamodel {
+
+    namespace {
+
+        /**
+         * The input of a lazily parsed document together with its
+         * structural index: the location of every array and object in
+         * document order.
+         */
+        struct json_document {
+            struct container {
+                // Offset of the opening bracket
+                size_t begin;
+                // Offset of the matching closing bracket
+                size_t end;
+                // Index of the first container which follows this subtree
+                size_t after;
+            };
+
+            std::string text;
+            std::vector<container> containers;
+
+            // Shared by all materializations of the document, which may run concurrently
+            mutable name_pool names;
+
+            node_name intern(std::string_view name) const {
+                return names.intern(name);
+            }
+        };
+
+        using shared_document = std::shared_ptr<const json_document>;
+
+
+        [[noreturn]] void throw_syntax_error(size_t offset, std::string_view problem) {
+            throw syntax_exception(fmt::format("Invalid JSON at offset {}: {}", offset, problem));
+        }
+
+
+        /**
+         * Match the JSON number grammar, `-? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)?`,
+         * which from_chars alone is more lenient than, e.g. about `01` or `1.`
+         * @return The offset after the number, or the start if there is none
+         */
+        size_t scan_number(std::string_view text, size_t start) {
+            const auto is_digit = [&text](size_t at) { return at < text.size() && text[at] >= '0' && text[at] <= '9'; };
+            const auto skip_digits = [&](size_t at) {
+                while (is_digit(at)) {
+                    at++;
+                }
+                return at;
+            };
+
+            auto pos = start;
+            if (pos < text.size() && text[pos] == '-') {
+                pos++;
+            }
+            if (!is_digit(pos)) {
+                return start;
+            }
+            pos = text[pos] == '0' ? pos + 1 : skip_digits(pos);
+            if (pos < text.size() && text[pos] == '.') {
+                if (!is_digit(pos + 1)) {
+                    return start;
+                }
+                pos = skip_digits(pos + 1);
+            }
+            if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+                pos++;
+                if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+                    pos++;
+                }
+                if (!is_digit(pos)) {
+                    return start;
+                }
+                pos = skip_digits(pos);
+            }
+            // Digits right after a leading zero, as in 01, are not part of any number
+            return is_digit(pos) ? start : pos;
+        }
+
+
+        /**
+         * Find the closing quote of the string starting at the given offset.
+         * @param text The document text
+         * @param pos The offset of the opening quote
+         * @return The offset of the closing quote
+         */
+        size_t find_string_end(std::string_view text, size_t pos) {
+            const auto start = pos;
+            pos++;
+            while (true) {
+                pos = text.find_first_of("\"\\", pos);
+                if (pos == std::string_view::npos) {
+                    throw_syntax_error(start, "unterminated string");
+                }
+                if (text[pos] == '"') {
+                    return pos;
+                }
+                // Skip the escaped character
+                pos += 2;
+            }
+        }
+
+
+        /**
+         * Check the unescaped text of a string like the eager parser does:
+         * control characters must be escaped and the rest must be well-formed
+         * UTF-8, without overlong forms, surrogates or code points past U+10FFFF.
+         * @param raw The text between the quotes
+         * @param offset The offset of the opening quote, for error messages
+         */
+        void validate_string(std::string_view raw, size_t offset) {
+            const auto byte = [&raw](size_t at) { return static_cast<unsigned char>(raw[at]); };
+            for (size_t pos = 0; pos < raw.size(); ) {
+                const auto lead = byte(pos);
+                if (lead >= 0x20 && lead < 0x80) {
+                    pos++;
+                    continue;
+                }
+                if (lead < 0x20) {
+                    throw_syntax_error(offset, "control characters in strings must be escaped");
+                }
+                // The range of the second byte depends on the lead byte, the others are plain continuations
+                size_t length = 0;
+                unsigned char low = 0x80;
+                unsigned char high = 0xBF;
+                if (lead >= 0xC2 && lead <= 0xDF) {
+                    length = 2;
+                } else if (lead >= 0xE0 && lead <= 0xEF) {
+                    length = 3;
+                    low = lead == 0xE0 ? 0xA0 : 0x80;
+                    high = lead == 0xED ? 0x9F : 0xBF;
+                } else if (lead >= 0xF0 && lead <= 0xF4) {
+                    length = 4;
+                    low = lead == 0xF0 ? 0x90 : 0x80;
+                    high = lead == 0xF4 ? 0x8F : 0xBF;
+                } else {
+                    throw_syntax_error(offset, "ill-formed UTF-8 in string");
+                }
+                if (pos + length > raw.size() || byte(pos + 1) < low || byte(pos + 1) > high) {
+                    throw_syntax_error(offset, "ill-formed UTF-8 in string");
+                }
+                for (size_t i = 2; i < length; i++) {
+                    if (byte(pos + i) < 0x80 || byte(pos + i) > 0xBF) {
+                        throw_syntax_error(offset, "ill-formed UTF-8 in string");
+                    }
+                }
+                pos += length;
+            }
+        }
+
+
+        /**
+         * Tell whether a number which does not fit a double is too large for
+         * it, rather than too close to zero
+         * @param number A number matching the JSON grammar
+         */
+        bool overflows(std::string_view number) {
+            // The decimal exponent of the first significant digit, relative to the exponent part
+            long long magnitude = 0;
+            bool significant = false;
+            bool fraction = false;
+            size_t pos = number.starts_with('-') ? 1 : 0;
+            for (; pos < number.size() && number[pos] != 'e' && number[pos] != 'E'; pos++) {
+                if (number[pos] == '.') {
+                    fraction = true;
+                } else if (!significant && number[pos] != '0') {
+                    significant = true;
+                    if (fraction) {
+                        magnitude--;
+                    }
+                } else if (!significant && fraction) {
+                    magnitude--;
+                } else if (significant && !fraction) {
+                    magnitude++;
+                }
+            }
+            long long exponent = 0;
+            if (pos < number.size()) {
+                const auto digits = number.substr(pos + 1 + (number[pos + 1] == '+' || number[pos + 1] == '-'));
+                const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), exponent);
+                if (error != std::errc()) {
+                    // More digits than a long long holds, far out of any double's range either way
+                    exponent = std::numeric_limits<long long>::max() / 2;
+                }
+                if (number[pos + 1] == '-') {
+                    exponent = -exponent;
+                }
+            }
+            return magnitude + exponent >= 0;
+        }
+
+
+        [[noreturn]] void throw_limit_exceeded(size_t offset, std::string_view problem) {
+            throw limit_exceeded_exception(fmt::format("JSON at offset {} {}", offset, problem));
+        }
+
+
+        void index_document(json_document &document, const parse_limits &limits) {
+            const std::string_view text = document.text;
+            std::vector<size_t> open;
+            for (size_t pos = 0; pos < text.size(); pos++) {
+                switch (text[pos]) {
+                case '"': {
+                    const auto start = pos;
+                    pos = find_string_end(text, pos);
+                    if (pos - start - 1 > limits.max_string_length) {
+                        throw_limit_exceeded(start, fmt::format(
+                            "contains a string longer than the maximum of {} bytes", limits.max_string_length));
+                    }
+                    break;
+                }
+                case '[':
+                case '{':
+                    if (open.size() >= limits.max_depth) {
+                        throw_limit_exceeded(pos, fmt::format("exceeds the maximum depth of {}", limits.max_depth));
+                    }
+                    if (text.size() + (document.containers.size() + 1) * sizeof(json_document::container) > limits.max_bytes) {
+                        throw_limit_exceeded(pos, fmt::format("exceeds the budget of {} bytes", limits.max_bytes));
+                    }
+                    open.push_back(document.containers.size());
+                    document.containers.push_back({pos, 0, 0});
+                    break;
+                case ']':
+                case '}': {
+                    if (open.empty()) {
+                        throw_syntax_error(pos, "unexpected closing bracket");
+                    }
+                    auto &container = document.containers[open.back()];
+                    if ((text[container.begin] == '{') != (text[pos] == '}')) {
+                        throw_syntax_error(pos, "mismatched closing bracket");
+                    }
+                    container.end = pos;
+                    container.after = document.containers.size();
+                    open.pop_back();
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            if (!open.empty()) {
+                throw_syntax_error(document.containers[open.back()].begin, "unterminated container");
+            }
+        }
+
+
+        /**
+         * Builds the direct children of one container from the document text,
+         * jumping over nested containers with the help of the structural index.
+         */
+        class lazy_value_reader {
+        public:
+            lazy_value_reader(shared_document document, size_t pos, size_t next_container)
+                : document(std::move(document)), text(this->document->text),
+                  pos(pos), next_container(next_container) {}
+
+            shared_node read_value(node_name name);
+            node_list read_array_children(std::string_view parent_name);
+            node_list read_object_children();
+
+            void skip_whitespace() {
+                while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n'
+                        || text[pos] == '\r' || text[pos] == '\t')) {
+                    pos++;
+                }
+            }
+
+            void expect_end() {
+                skip_whitespace();
+                if (pos != text.size()) {
+                    throw_syntax_error(pos, "unexpected trailing characters");
+                }
+            }
+
+        private:
+            std::string read_string();
+            literal_value read_number();
+            bool consume(char expected);
+
+            shared_document document;
+            std::string_view text;
+            size_t pos;
+            size_t next_container;
+        };
+
+
+        class lazy_array_node : public array_node {
+        public:
+            lazy_array_node(node_name name, shared_document document, size_t index)
+                : array_node(std::move(name)), document(std::move(document)), index(index) {}
+
+            void freeze() override {
+                if (materialized.load(std::memory_order_acquire)) {
+                    array_node::freeze();
+                } else {
+                    node::freeze();
+                }
+            }
+
+        protected:
+            void materialize() const override {
+                std::call_once(once, [this] {
+                    const auto &container = document->containers[index];
+                    lazy_value_reader reader(document, container.begin + 1, index + 1);
+                    auto children = reader.read_array_children(name());
+                    if (is_frozen()) {
+                        for (const auto &child : children) {
+                            child->freeze();
+                        }
+                    }
+                    assign_children(std::move(children));
+                    materialized.store(true, std::memory_order_release);
+                });
+            }
+
+        private:
+            shared_document document;
+            size_t index;
+            mutable std::once_flag once;
+            mutable std::atomic<bool> materialized = false;
+        };
+
+
+        class lazy_object_node : public object_node {
+        public:
+            lazy_object_node(node_name name, shared_document document, size_t index)
+                : object_node(std::move(name)), document(std::move(document)), index(index) {}
+
+            void freeze() override {
+                if (materialized.load(std::memory_order_acquire)) {
+                    object_node::freeze();
+                } else {
+                    node::freeze();
+                }
+            }
+
+        protected:
+            void materialize() const override {
+                std::call_once(once, [this] {
+                    const auto &container = document->containers[index];
+                    lazy_value_reader reader(document, container.begin + 1, index + 1);
+                    auto children = reader.read_object_children();
+                    if (is_frozen()) {
+                        for (const auto &child : children) {
+                            child->freeze();
+                        }
+                    }
+                    assign_children(std::move(children));
+                    materialized.store(true, std::memory_order_release);
+                });
+            }
+
+        private:
+            shared_document document;
+            size_t index;
+            mutable std::once_flag once;
+            mutable std::atomic<bool> materialized = false;
+        };
+
+
+        shared_node lazy_value_reader::read_value(node_name name) {
+            skip_whitespace();
+            if (pos >= text.size()) {
+                throw_syntax_error(pos, "expected a value");
+            }
+
+            switch (text[pos]) {
+            case '[':
+            case '{': {
+                if (next_container >= document->containers.size()
+                        || document->containers[next_container].begin != pos) {
+                    throw_syntax_error(pos, "unexpected container");
+                }
+                const auto &container = document->containers[next_container];
+                shared_node value;
+                if (text[pos] == '[') {
+                    value = std::make_shared<lazy_array_node>(std::move(name), document, next_container);
+                } else {
+                    value = std::make_shared<lazy_object_node>(std::move(name), document, next_container);
+                }
+                pos = container.end + 1;
+                next_container = container.after;
+                return value;
+            }
+            case '"':
+                return make_literal(std::move(name), read_string());
+            case 't':
+                if (text.substr(pos, 4) == "true") {
+                    pos += 4;
+                    return make_literal(std::move(name), true);
+                }
+                break;
+            case 'f':
+                if (text.substr(pos, 5) == "false") {
+                    pos += 5;
+                    return make_literal(std::move(name), false);
+                }
+                break;
+            case 'n':
+                if (text.substr(pos, 4) == "null") {
+                    pos += 4;
+                    return make_literal(std::move(name), nullptr);
+                }
+                break;
+            default:
+                return make_literal(std::move(name), read_number());
+            }
+            throw_syntax_error(pos, "invalid literal");
+        }
+
+
+        node_list lazy_value_reader::read_array_children(std::string_view parent_name) {
+            node_list children;
+            skip_whitespace();
+            if (consume(']')) {
+                return children;
+            }
+            do {
+                // Element names are unique, so they are not pooled
+                children.push_back(read_value(fmt::format("{}[{}]", parent_name, children.size())));
+                skip_whitespace();
+            } while (consume(','));
+            if (!consume(']')) {
+                throw_syntax_error(pos, "expected ',' or ']'");
+            }
+            return children;
+        }
+
+
+        node_list lazy_value_reader::read_object_children() {
+            node_list children;
+            std::unordered_set<std::string_view> names;
+            skip_whitespace();
+            if (consume('}')) {
+                return children;
+            }
+            do {
+                skip_whitespace();
+                if (pos >= text.size() || text[pos] != '"') {
+                    throw_syntax_error(pos, "expected a member name");
+                }
+                auto name = document->intern(read_string());
+                skip_whitespace();
+                if (!consume(':')) {
+                    throw_syntax_error(pos, "expected ':'");
+                }
+                auto child = read_value(std::move(name));
+                if (!names.insert(child->name()).second) {
+                    throw duplicate_key_exception(fmt::format(
+                        "Unable to add {} to object at offset {} as there already exists an element with that name",
+                        child->name(), pos));
+                }
+                children.push_back(std::move(child));
+                skip_whitespace();
+            } while (consume(','));
+            if (!consume('}')) {
+                throw_syntax_error(pos, "expected ',' or '}'");
+            }
+            return children;
+        }
+
+
+        std::string lazy_value_reader::read_string() {
+            const auto start = pos;
+            const auto end = find_string_end(text, pos);
+            pos = end + 1;
+            const auto raw = text.substr(start + 1, end - start - 1);
+            if (raw.find('\\') == std::string_view::npos) {
+                validate_string(raw, start);
+                return std::string(raw);
+            }
+            // Let nlohmann deal with the escape sequences
+            try {
+                return nlohmann::json::parse(text.substr(start, end - start + 1)).get<std::string>();
+            } catch (const nlohmann::json::exception &e) {
+                throw_syntax_error(start, e.what());
+            }
+        }
+
+
+        literal_value lazy_value_reader::read_number() {
+            const auto start = pos;
+            const auto end = scan_number(text, start);
+            if (end == start) {
+                throw_syntax_error(start, "invalid number");
+            }
+            const auto number = text.substr(start, end - start);
+            pos = end;
+            // Integers are read as such by the eager parser, which turns -0 into 0
+            if (number == "-0") {
+                return 0.0;
+            }
+            num_type value = 0.0;
+            const auto [parsed_end, error] = std::from_chars(number.data(), number.data() + number.size(), value);
+            // Like the eager parser, reject numbers beyond the largest double and round those below the smallest to zero
+            if (error == std::errc::result_out_of_range) {
+                if (overflows(number)) {
+                    throw_syntax_error(start, "number overflow");
+                }
+                return number.starts_with('-') ? -0.0 : 0.0;
+            }
+            if (error != std::errc() || parsed_end != number.data() + number.size()) {
+                throw_syntax_error(start, "invalid number");
+            }
+            return value;
+        }
+
+
+        bool lazy_value_reader::consume(char expected) {
+            if (pos < text.size() && text[pos] == expected) {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::lazy_json_parser
+     *
+     ************************************************************/
+
+
+    shared_node lazy_json_parser::parse(std::string_view input) {
+        auto document = std::make_shared<json_document>();
+        if (input.size() > limits.max_bytes) {
+            throw_limit_exceeded(0, fmt::format("exceeds the budget of {} bytes", limits.max_bytes));
+        }
+        document->text = std::string(input);
+        index_document(*document, limits);
+
+        lazy_value_reader reader(document, 0, 0);
+        auto root = reader.read_value("RootNode");
+        reader.expect_end();
+        return root;
+    }
+
+}
@@ -1,47 +1,444 @@
-
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 #include <vole/exception.hpp>
 #include <vole/datamodel.hpp>
 #include <vole/datamodel_parsers.hpp>
-#include <vole/node_printer.hpp>
+#include <vole/model_cache.hpp>
+#include <vole/model_composer.hpp>
+#include <vole/output_sink.hpp>
+#include <vole/output_writer.hpp>
+#include <vole/profiler.hpp>
+#include <vole/thread_pool.hpp>
+
+#include "render_service.hpp"
 
 /**
- * Read a file from the filesystem and return it as a string
- * @param path The path to the file
- * @return A std::string containing the contents of the file
+ * The command line configuration of a vole_renderer run
  */
-std::string load_file(const std::filesystem::path &path) {
-    std::ifstream file(path, std::ios::in);
-    if (file.is_open() == false) {
-        throw std::runtime_error("Failed to open file");
+struct options {
+    std::optional<vole::datamodel::model_format> format;
+    // Model files, directories and @response files, as given
+    std::vector<std::string> inputs;
+    // Model files composed into a single model instead of the inputs
+    std::vector<vole::model_mount> mounts;
+    std::optional<std::filesystem::path> output;
+    // Number of models processed concurrently, zero for one per hardware thread
+    size_t jobs = 0;
+    // Run as a render server listening on this socket
+    std::optional<std::filesystem::path> serve_socket;
+    // Hand the work to the render server listening on this socket
+    std::optional<std::filesystem::path> connect_socket;
+    bool shutdown = false;
+    // Keep running and render models again when they change
+    bool watch = false;
+    // Write a Chrome trace of the run to this file
+    std::optional<std::filesystem::path> profile;
+    // Limits given on the command line, the others keep their defaults
+    std::optional<size_t> max_depth;
+    std::optional<size_t> max_nodes;
+    std::optional<size_t> max_bytes;
+    std::optional<size_t> max_string_length;
+
+    /**
+     * The limits to parse models with, starting from the given defaults
+     */
+    [[nodiscard]] vole::datamodel::parse_limits limits(vole::datamodel::parse_limits defaults) const {
+        defaults.max_depth = max_depth.value_or(defaults.max_depth);
+        defaults.max_nodes = max_nodes.value_or(defaults.max_nodes);
+        defaults.max_bytes = max_bytes.value_or(defaults.max_bytes);
+        defaults.max_string_length = max_string_length.value_or(defaults.max_string_length);
+        return defaults;
     }
-    std::istreambuf_iterator<char> fitr{file}, end;
-    return {fitr, end};
+};
+
+void print_usage(const char *program) {
+    std::cerr
+        << "Usage: " << program << " [options] <file|directory|@list>...\n"
+        << "       " << program << " --serve <socket>\n"
+        << "       " << program << " [options] --mount <path=file>...\n"
+        << "       " << program << " --connect <socket> [options] <file|directory|@list>...\n"
+        << "       " << program << " --connect <socket> --shutdown\n"
+        << "Options:\n"
+        << "  --format json|cbor|msgpack  Model encoding, guessed from the extension by default\n"
+        << "  --output <path>             Write the rendering to a file instead of stdout.\n"
+        << "                              With several inputs or a directory or @list input, a\n"
+        << "                              directory receiving <model>.txt, laid out like the input\n"
+        << "                              directories\n"
+        << "  -j <count>                  Number of models processed concurrently\n"
+        << "  --mount <path=file>         Mount a model file at a member path of one composed model,\n"
+        << "                              replacing what an earlier mount put there. path+=file\n"
+        << "                              merges objects instead. The file name may be a glob, whose\n"
+        << "                              matches are mounted at path.<name>. Repeat for each file\n"
+        << "  --watch                     Keep the models loaded and render them again when they change\n"
+        << "  --profile <trace.json>      Write a Chrome trace of the run, and a summary to stderr.\n"
+        << "                              Requires a build with VOLE_ENABLE_PROFILER, not with --serve\n"
+        << "  --max-depth <count>         Deepest nesting of arrays and objects a model may have\n"
+        << "  --max-nodes <count>         Most nodes one model may have\n"
+        << "  --max-bytes <count>         Most memory the nodes of one model may take\n"
+        << "  --max-string-length <count> Longest string, member name or binary a model may hold.\n"
+        << "                              Without these, models are only limited in depth, except\n"
+        << "                              with --serve, which limits every model to a share of memory\n";
 }
 
-void load_and_display_model(std::string_view filename) {
-    vole::datamodel::json_parser parser;
-    auto model = parser.parse(load_file(filename));
-    vole::node_printer renderer;
-    std::cout << renderer.render(*model) << std::endl;
+/**
+ * Parse a count given on the command line
+ * @return Whether the whole text is a count
+ */
+bool parse_count(std::string_view text, size_t &count) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+    return error == std::errc() && end == text.data() + text.size();
 }
 
+/**
+ * Parse the command line
+ * @return The options, or nothing if the command line is invalid
+ */
+std::optional<options> parse_options(const int argc, const char* argv[]) {
+    options result;
+    const std::map<std::string_view, std::optional<size_t> options::*> limit_options = {
+        {"--max-depth", &options::max_depth},
+        {"--max-nodes", &options::max_nodes},
+        {"--max-bytes", &options::max_bytes},
+        {"--max-string-length", &options::max_string_length},
+    };
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        const auto limit = limit_options.find(arg);
+        if (arg == "--format" && has_value) {
+            result.format = vole::datamodel::format_from_name(argv[++i]);
+        } else if (arg == "--output" && has_value) {
+            result.output = argv[++i];
+        } else if (arg == "-j" && has_value) {
+            if (!parse_count(argv[++i], result.jobs)) {
+                return std::nullopt;
+            }
+        } else if (limit != limit_options.end() && has_value) {
+            size_t count = 0;
+            if (!parse_count(argv[++i], count)) {
+                return std::nullopt;
+            }
+            result.*(limit->second) = count;
+        } else if (arg == "--serve" && has_value) {
+            result.serve_socket = argv[++i];
+        } else if (arg == "--connect" && has_value) {
+            result.connect_socket = argv[++i];
+        } else if (arg == "--shutdown") {
+            result.shutdown = true;
+        } else if (arg == "--mount" && has_value) {
+            result.mounts.push_back(vole::parse_mount(argv[++i]));
+        } else if (arg == "--watch") {
+            result.watch = true;
+        } else if (arg == "--profile" && has_value) {
+            result.profile = argv[++i];
+        } else if (!arg.starts_with("-")) {
+            result.inputs.emplace_back(arg);
+        } else {
+            return std::nullopt;
+        }
+    }
 
-int main(const int argc, const char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <file>" << std::endl;
-        return EXIT_FAILURE;
+    if (result.serve_socket.has_value()) {
+        // A server runs until it is shut down, there is no end of the run to write a profile at
+        return result.inputs.empty() && !result.connect_socket.has_value() && !result.profile.has_value()
+            ? std::optional(result) : std::nullopt;
+    }
+    if (result.shutdown) {
+        return result.connect_socket.has_value() ? std::optional(result) : std::nullopt;
+    }
+    const bool has_limits = result.max_depth || result.max_nodes || result.max_bytes || result.max_string_length;
+    if (has_limits && result.connect_socket.has_value()) {
+        // The server parses with the limits it was started with
+        return std::nullopt;
+    }
+    if (result.watch && result.connect_socket.has_value()) {
+        // The server keeps its own models, so there is nothing to watch locally
+        return std::nullopt;
     }
+    if (!result.mounts.empty()) {
+        return result.inputs.empty() && !result.watch ? std::optional(result) : std::nullopt;
+    }
+    return result.inputs.empty() ? std::nullopt : std::optional(result);
+}
+
+/**
+ * Write the recorded profile: the trace to the given file, the folded
+ * stacks next to it and the summary to stderr
+ */
+void write_profile(const std::filesystem::path &trace_path) {
+    std::ofstream trace(trace_path);
+    vole::profiler::write_trace(trace);
+    auto folded_path = trace_path;
+    folded_path += ".folded";
+    std::ofstream folded(folded_path);
+    vole::profiler::write_folded(folded);
+    vole::profiler::write_summary(std::cerr);
+    if (!trace || !folded) {
+        throw std::runtime_error("Failed to write profile " + trace_path.string());
+    }
+}
 
+bool is_model_file(const std::filesystem::path &path) {
+    const auto extension = path.extension();
+    return extension == ".json" || extension == ".cbor" || extension == ".msgpack" || extension == ".mpk";
+}
+
+/**
+ * A model file to render
+ */
+struct model_input {
+    std::filesystem::path file;
+    // Where the rendering goes within the output directory, without the .txt:
+    // the path below the input directory the file was found in, or its file name
+    std::filesystem::path name;
+};
+
+/**
+ * Turn the inputs of the command line into the list of model files.
+ * Directories contribute every model file below them, in sorted order,
+ * and @file arguments name response files listing one input per line.
+ * @return Whether the input was a directory or response file, whose
+ *         renderings go into an output directory however many models it held
+ * @throws std::runtime_error if a directory or response file holds no models
+ */
+bool expand_input(std::string_view input, std::vector<model_input> &models) {
+    const auto previous = models.size();
+    if (input.starts_with('@')) {
+        std::ifstream list{std::filesystem::path(input.substr(1))};
+        if (!list.is_open()) {
+            throw std::runtime_error("Failed to open response file " + std::string(input.substr(1)));
+        }
+        std::string line;
+        while (std::getline(list, line)) {
+            const auto first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') {
+                continue;
+            }
+            const auto last = line.find_last_not_of(" \t\r");
+            expand_input(std::string_view(line).substr(first, last - first + 1), models);
+        }
+        if (models.size() == previous) {
+            throw std::runtime_error("Response file " + std::string(input.substr(1)) + " lists no models");
+        }
+        return true;
+    }
+
+    const std::filesystem::path path(input);
+    if (std::filesystem::is_directory(path)) {
+        std::vector<std::filesystem::path> found;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && is_model_file(entry.path())) {
+                found.push_back(entry.path());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (auto &file : found) {
+            auto name = file.lexically_relative(path);
+            models.push_back({std::move(file), std::move(name)});
+        }
+        if (models.size() == previous) {
+            throw std::runtime_error("No model files found in " + path.string());
+        }
+        return true;
+    }
+    models.push_back({path, path.filename()});
+    return false;
+}
+
+/**
+ * Make sure no two models would be rendered into the same output file,
+ * which would leave whichever finished last
+ * @throws std::runtime_error naming the first two models which collide
+ */
+void check_output_names(const std::vector<model_input> &models) {
+    std::map<std::filesystem::path, const std::filesystem::path *> outputs;
+    for (const auto &model : models) {
+        const auto [existing, added] = outputs.emplace(model.name.lexically_normal(), &model.file);
+        if (!added) {
+            throw std::runtime_error(fmt::format("{} and {} would both be written to {}.txt",
+                existing->second->string(), model.file.string(), model.name.string()));
+        }
+    }
+}
+
+/**
+ * Drop the models of a job from the cache. Every model of a batch run
+ * is rendered once, so it only has to stay resident while it is rendered.
+ */
+void release_models(vole::model_cache &cache, const vole::renderer::render_job &job) {
+    if (job.mounts.empty()) {
+        cache.invalidate(job.model);
+    }
+    for (const auto &mount : job.mounts) {
+        cache.invalidate(mount.file);
+    }
+}
+
+
+int main(const int argc, const char* argv[]) {
+    std::optional<options> parsed;
+    std::vector<model_input> models;
+    // Whether --output names a directory receiving one file per model
+    bool output_directory = false;
     try {
-        load_and_display_model(argv[0]);
+        parsed = parse_options(argc, argv);
+        if (!parsed.has_value()) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (parsed->profile.has_value()) {
+            if (!vole::profiler::compiled_in) {
+                std::cerr << "Error: --profile requires a build with VOLE_ENABLE_PROFILER" << std::endl;
+                return EXIT_FAILURE;
+            }
+            vole::profiler::enable();
+        }
+
+        if (parsed->serve_socket.has_value()) {
+            vole::renderer::serve(parsed->serve_socket.value(), parsed->limits(vole::renderer::default_server_limits()));
+            return EXIT_SUCCESS;
+        }
+
+        if (parsed->connect_socket.has_value() && parsed->shutdown) {
+            vole::renderer::request_shutdown(parsed->connect_socket.value());
+            return EXIT_SUCCESS;
+        }
+
+        for (const auto &input : parsed->inputs) {
+            output_directory |= expand_input(input, models);
+        }
+        if (!parsed->mounts.empty()) {
+            // Resolved here, so that a server sees the same files
+            parsed->mounts = vole::expand_mounts(parsed->mounts);
+            for (auto &mount : parsed->mounts) {
+                mount.file = std::filesystem::absolute(mount.file);
+                mount.format = mount.format.has_value() ? mount.format : parsed->format;
+            }
+            models.push_back({"<mounts>", "<mounts>"});
+        }
+        output_directory = output_directory || models.size() > 1;
+        if (output_directory && parsed->output.has_value()) {
+            check_output_names(models);
+            if (parsed->connect_socket.has_value()) {
+                // The server writes the files itself; locally the output_writer creates directories
+                for (const auto &model : models) {
+                    std::filesystem::create_directories((parsed->output.value() / model.name).parent_path());
+                }
+            }
+        }
     } catch (std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
+    const auto &opts = parsed.value();
+    // Watching keeps every model resident; a batch run drops each one once it is rendered
+    vole::model_cache cache(opts.limits({}), opts.watch
+        ? std::max(vole::model_cache::default_capacity, models.size() + opts.mounts.size())
+        : vole::model_cache::default_capacity);
+    vole::output_writer writer;
+    std::vector<vole::renderer::render_job> jobs;
+    for (const auto &model : models) {
+        vole::renderer::render_job job {std::filesystem::absolute(model.file), opts.format, std::nullopt, opts.mounts};
+        if (opts.output.has_value()) {
+            job.output = std::filesystem::absolute(output_directory
+                ? opts.output.value() / (model.name.string() + ".txt")
+                : opts.output.value());
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    std::vector<std::future<std::string>> results;
+    {
+        const size_t threads = opts.jobs == 0 ? std::thread::hardware_concurrency() : opts.jobs;
+        vole::thread_pool pool(std::min(threads, models.size()));
+        for (auto job : jobs) {
+            results.push_back(pool.submit([&opts, &cache, &writer, &models, job = std::move(job)]() mutable {
+                if (opts.connect_socket.has_value()) {
+                    return vole::renderer::submit(opts.connect_socket.value(), job);
+                }
+                auto document = vole::renderer::load_model(cache, job);
+                if (!opts.watch) {
+                    release_models(cache, job);
+                }
+                if (job.output.has_value()) {
+                    // Rendered on this thread, straight into the file
+                    writer.write(job.output.value(), [&document](vole::output_sink &sink) {
+                        vole::renderer::render_model(document, sink);
+                    });
+                    return std::string();
+                }
+                if (models.size() == 1) {
+                    // Nothing to keep in order with, so stream to stdout
+                    vole::stream_sink sink(std::cout);
+                    vole::renderer::render_model(document, sink);
+                    return std::string();
+                }
+                std::string text;
+                vole::string_sink sink(text);
+                vole::renderer::render_model(document, sink);
+                return text;
+            }));
+        }
+
+        // Report in input order, regardless of which model finished first
+        size_t failures = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            try {
+                std::cout << results[i].get();
+            } catch (std::exception &e) {
+                std::cout.flush();
+                std::cerr << "Error: " << models[i].file.string() << ": " << e.what() << std::endl;
+                failures++;
+            }
+        }
+        for (const auto &failure : writer.wait()) {
+            std::cerr << "Error: " << failure.path.string() << ": " << failure.message << std::endl;
+            failures++;
+        }
+        if (output_directory) {
+            std::cerr << models.size() - failures << " of " << models.size() << " models rendered" << std::endl;
+        }
+        if (opts.profile.has_value()) {
+            try {
+                write_profile(opts.profile.value());
+            } catch (std::exception &e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                failures++;
+            }
+        }
+        if (failures > 0 && !opts.watch) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (opts.watch) {
+        try {
+            std::cerr << "Watching " << models.size() << " models for changes" << std::endl;
+            vole::renderer::watch(cache, jobs, [](const auto &job, const std::string &output, const std::exception *error) {
+                if (error != nullptr) {
+                    std::cerr << "Error: " << job.model.string() << ": " << error->what() << std::endl;
+                    return;
+                }
+                std::cout << output << std::flush;
+                std::cerr << "Rendered " << job.model.string() << std::endl;
+            });
+        } catch (std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,113 @@
+#include "vole/model_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    std::string read_file(const std::filesystem::path &path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (file.is_open() == false) {
+            throw no_such_element_exception(fmt::format("Failed to open file {}", path.string()));
+        }
+        std::istreambuf_iterator<char> fitr{file}, end;
+        return {fitr, end};
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::model_cache
+     *
+     ************************************************************/
+
+
+    model_cache::model_cache(const datamodel::parse_limits &limits, size_t capacity)
+        : limits(limits), capacity(std::max<size_t>(capacity, 1))
+    {}
+
+
+    datamodel::frozen_document model_cache::get(
+            const std::filesystem::path &path,
+            std::optional<datamodel::model_format> format) {
+        VOLE_PROFILE_ZONE("load model");
+        const auto key = cache_key(path);
+        const auto modified = std::filesystem::last_write_time(path);
+        const auto file_size = std::filesystem::file_size(path);
+        const auto model_format = format.value_or(datamodel::format_from_path(path));
+
+        {
+            std::lock_guard lock(mutex);
+            const auto existing = entries.find(key);
+            if (existing != entries.end() && existing->second.format == model_format
+                    && existing->second.modified == modified && existing->second.file_size == file_size) {
+                existing->second.last_used = ++uses;
+                return existing->second.document;
+            }
+        }
+
+        // Read and parse outside of the lock so other models can be served meanwhile
+        const auto content = read_file(path);
+        const auto digest = datamodel::keyed_digest(content);
+
+        std::unique_lock lock(mutex);
+        auto existing = entries.find(key);
+        if (existing != entries.end() && existing->second.format == model_format
+                && existing->second.digest == digest) {
+            // Touched, but not changed
+            existing->second.modified = modified;
+            existing->second.file_size = file_size;
+            existing->second.last_used = ++uses;
+            return existing->second.document;
+        }
+        lock.unlock();
+
+        auto document = [&] {
+            VOLE_PROFILE_ZONE("parse model");
+            return datamodel::freeze(datamodel::make_parser(model_format, limits)->parse(content));
+        }();
+
+        lock.lock();
+        entries.erase(key);
+        make_room();
+        entries.emplace(key, entry{modified, file_size, digest, model_format, document, ++uses});
+        return document;
+    }
+
+
+    void model_cache::make_room() {
+        while (entries.size() >= capacity) {
+            const auto oldest = std::min_element(entries.begin(), entries.end(),
+                [](const auto &a, const auto &b) { return a.second.last_used < b.second.last_used; });
+            entries.erase(oldest);
+        }
+    }
+
+
+    void model_cache::invalidate(const std::filesystem::path &path) {
+        std::lock_guard lock(mutex);
+        entries.erase(cache_key(path));
+    }
+
+
+    void model_cache::clear() {
+        std::lock_guard lock(mutex);
+        entries.clear();
+    }
+
+
+    size_t model_cache::size() const {
+        std::lock_guard lock(mutex);
+        return entries.size();
+    }
+
+
+    std::string model_cache::cache_key(const std::filesystem::path &path) {
+        return std::filesystem::absolute(path).lexically_normal().string();
+    }
+
+}
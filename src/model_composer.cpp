@@ -0,0 +1,269 @@
+#include "vole/model_composer.hpp"
+
+#include <algorithm>
+#include <future>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <fmt/format.h>
+
+#include "vole/columnar_array.hpp"
+#include "vole/exception.hpp"
+#include "vole/profiler.hpp"
+#include "vole/thread_pool.hpp"
+
+namespace vole {
+
+    namespace {
+
+        using datamodel::shared_node;
+
+        bool is_glob(std::string_view name) {
+            return name.find_first_of("*?") != std::string_view::npos;
+        }
+
+
+        bool matches_glob(std::string_view name, std::string_view pattern) {
+            size_t n = 0;
+            size_t p = 0;
+            // Where to retry when the text after the last '*' fails to match
+            size_t star = std::string_view::npos;
+            size_t resume = 0;
+            while (n < name.size()) {
+                if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+                    n++;
+                    p++;
+                } else if (p < pattern.size() && pattern[p] == '*') {
+                    star = p++;
+                    resume = n;
+                } else if (star != std::string_view::npos) {
+                    p = star + 1;
+                    n = ++resume;
+                } else {
+                    return false;
+                }
+            }
+            while (p < pattern.size() && pattern[p] == '*') {
+                p++;
+            }
+            return p == pattern.size();
+        }
+
+
+        std::vector<std::string_view> split_path(std::string_view path) {
+            std::vector<std::string_view> segments;
+            if (path.empty()) {
+                return segments;
+            }
+            for (size_t start = 0; start <= path.size(); ) {
+                const auto end = std::min(path.find('.', start), path.size());
+                if (end == start) {
+                    throw syntax_exception(fmt::format("Empty member name in mount path '{}'", path));
+                }
+                segments.push_back(path.substr(start, end - start));
+                start = end + 1;
+            }
+            return segments;
+        }
+
+
+        /**
+         * Index the members of an object by name. The first of several
+         * members with the same name wins, as with object_node::get_child().
+         */
+        std::unordered_map<std::string_view, const shared_node *> index_members(const datamodel::object_node &object) {
+            const auto &members = object.get_children();
+            std::unordered_map<std::string_view, const shared_node *> index;
+            index.reserve(members.size());
+            for (const auto &member : members) {
+                index.emplace(member->name(), &member);
+            }
+            return index;
+        }
+
+
+        /**
+         * Copy a node under another name. Array elements are named after
+         * their array, e.g. `list[0]`, so they are renamed along with it.
+         * Everything else is shared.
+         */
+        shared_node rename(const datamodel::node &source, datamodel::node_name name) {
+            if (const auto literal = dynamic_cast<const datamodel::literal_node *>(&source)) {
+                return datamodel::make_literal(std::move(name), literal->get_value());
+            }
+            if (const auto columnar = dynamic_cast<const datamodel::columnar_array_node *>(&source);
+                    columnar != nullptr && columnar->is_columnar()) {
+                return columnar->copy_as(std::move(name));
+            }
+            if (const auto array = dynamic_cast<const datamodel::array_node *>(&source)) {
+                auto copy = datamodel::make_array(std::move(name));
+                const auto &elements = array->get_children();
+                for (size_t i = 0; i < elements.size(); i++) {
+                    copy->add_child(rename(*elements[i], fmt::format("{}[{}]", copy->name(), i)));
+                }
+                return copy;
+            }
+            const auto &object = dynamic_cast<const datamodel::object_node &>(source);
+            auto copy = datamodel::make_object(std::move(name));
+            for (const auto &child : object.get_children()) {
+                copy->add_child(child);
+            }
+            return copy;
+        }
+
+
+        /**
+         * Merge two nodes of the same name. Members of the incoming object
+         * win over those of the existing one, except that objects on both
+         * sides are merged in turn.
+         */
+        shared_node merge_nodes(const shared_node &existing, const shared_node &incoming) {
+            const auto existing_object = dynamic_cast<const datamodel::object_node *>(existing.get());
+            const auto incoming_object = dynamic_cast<const datamodel::object_node *>(incoming.get());
+            if (existing_object == nullptr || incoming_object == nullptr) {
+                return incoming;
+            }
+
+            const auto incoming_members = index_members(*incoming_object);
+            const auto existing_members = index_members(*existing_object);
+            auto merged = datamodel::make_object(existing->name_handle());
+            for (const auto &child : existing_object->get_children()) {
+                const auto replacement = incoming_members.find(child->name());
+                merged->add_child(replacement == incoming_members.end() ? child : merge_nodes(child, *replacement->second));
+            }
+            for (const auto &child : incoming_object->get_children()) {
+                if (!existing_members.contains(child->name())) {
+                    merged->add_child(child);
+                }
+            }
+            return merged;
+        }
+
+
+        /**
+         * Mount a node below an existing one, copying the objects along the
+         * path and sharing everything else
+         * @param existing The node currently at this level, or null if there is none
+         * @param name The name of the node at this level
+         * @param segments The rest of the mount path
+         * @param mounted The node to mount, already named after the last segment
+         * @return The node which takes the place of existing
+         */
+        shared_node mount_at(const shared_node &existing, const datamodel::node_name &name,
+                             std::span<const std::string_view> segments, const shared_node &mounted,
+                             mount_mode mode) {
+            if (segments.empty()) {
+                return existing == nullptr || mode == mount_mode::replace ? mounted : merge_nodes(existing, mounted);
+            }
+            const auto object = dynamic_cast<const datamodel::object_node *>(existing.get());
+            if (existing != nullptr && object == nullptr) {
+                throw invalid_operation_exception(
+                    fmt::format("Unable to mount below {} as it is an {}", existing->name(), existing->type()));
+            }
+
+            const datamodel::node_name child_name(std::string(segments.front()));
+            auto result = datamodel::make_object(name);
+            bool placed = false;
+            if (object != nullptr) {
+                for (const auto &child : object->get_children()) {
+                    if (child->name_handle() == child_name) {
+                        result->add_child(mount_at(child, child_name, segments.subspan(1), mounted, mode));
+                        placed = true;
+                    } else {
+                        result->add_child(child);
+                    }
+                }
+            }
+            if (!placed) {
+                result->add_child(mount_at(nullptr, child_name, segments.subspan(1), mounted, mode));
+            }
+            return result;
+        }
+
+    }
+
+
+    /************************************************************
+     *
+     *                  model composition
+     *
+     ************************************************************/
+
+
+    model_mount parse_mount(std::string_view spec) {
+        const auto separator = spec.find('=');
+        if (separator == std::string_view::npos || separator + 1 == spec.size()) {
+            throw syntax_exception(fmt::format("Expected path=file or path+=file, got '{}'", spec));
+        }
+        model_mount mount;
+        const bool merge = separator > 0 && spec[separator - 1] == '+';
+        mount.path = spec.substr(0, merge ? separator - 1 : separator);
+        mount.file = spec.substr(separator + 1);
+        mount.mode = merge ? mount_mode::merge : mount_mode::replace;
+        static_cast<void>(split_path(mount.path));
+        return mount;
+    }
+
+
+    std::vector<model_mount> expand_mounts(const std::vector<model_mount> &mounts) {
+        std::vector<model_mount> expanded;
+        for (const auto &mount : mounts) {
+            const auto pattern = mount.file.filename().string();
+            if (!is_glob(pattern)) {
+                expanded.push_back(mount);
+                continue;
+            }
+
+            const auto directory = mount.file.has_parent_path() ? mount.file.parent_path() : ".";
+            std::vector<std::filesystem::path> matches;
+            for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+                if (entry.is_regular_file() && matches_glob(entry.path().filename().string(), pattern)) {
+                    matches.push_back(entry.path());
+                }
+            }
+            if (matches.empty()) {
+                throw no_such_element_exception(fmt::format("No model file matches {}", mount.file.string()));
+            }
+            std::sort(matches.begin(), matches.end());
+            for (auto &match : matches) {
+                auto stem = match.stem().string();
+                expanded.push_back({
+                    mount.path.empty() ? std::move(stem) : mount.path + '.' + stem,
+                    std::move(match), mount.mode, mount.format,
+                });
+            }
+        }
+        return expanded;
+    }
+
+
+    datamodel::frozen_document compose_models(const std::vector<model_mount> &mounts,
+                                              model_cache &cache, size_t threads) {
+        VOLE_PROFILE_ZONE("compose models");
+        const auto expanded = expand_mounts(mounts);
+        const datamodel::node_name root_name("RootNode");
+        shared_node root = datamodel::make_object(root_name);
+        if (expanded.empty()) {
+            return datamodel::freeze(std::move(root));
+        }
+
+        const size_t workers = threads == 0 ? std::thread::hardware_concurrency() : threads;
+        thread_pool pool(std::clamp<size_t>(workers, 1, expanded.size()));
+        std::vector<std::future<datamodel::frozen_document>> documents;
+        documents.reserve(expanded.size());
+        for (const auto &mount : expanded) {
+            documents.push_back(pool.submit([&cache, &mount] { return cache.get(mount.file, mount.format); }));
+        }
+
+        // Mount in order while the later files are still being loaded
+        for (size_t i = 0; i < expanded.size(); i++) {
+            const auto document = documents[i].get();
+            const auto segments = split_path(expanded[i].path);
+            const auto mounted = rename(document.root(),
+                segments.empty() ? root_name : datamodel::node_name(std::string(segments.back())));
+            root = mount_at(root, root_name, segments, mounted, expanded[i].mode);
+        }
+        return datamodel::freeze(std::move(root));
+    }
+
+}
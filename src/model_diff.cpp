@@ -0,0 +1,167 @@
+#include "vole/model_diff.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace vole::datamodel {
+
+    namespace {
+
+        /**
+         * Walks two trees in step. The path of the current position is kept
+         * in one buffer, which is extended and truncated around each step.
+         */
+        class tree_differ {
+        public:
+            explicit tree_differ(std::vector<model_change> &changes)
+                : changes(changes) {}
+
+            void compare(const node &before, const node &after) {
+                if (&before == &after) {
+                    return;
+                }
+                // Mutable trees would compute their hashes from scratch, which costs more than it saves.
+                // The hash is keyed and 64 bits wide, so equal hashes are taken as equal subtrees.
+                if (before.is_frozen() && after.is_frozen() && before.subtree_hash() == after.subtree_hash()) {
+                    return;
+                }
+
+                const auto before_object = dynamic_cast<const object_node *>(&before);
+                const auto after_object = dynamic_cast<const object_node *>(&after);
+                if (before_object != nullptr && after_object != nullptr) {
+                    compare_members(*before_object, *after_object);
+                    return;
+                }
+
+                const auto before_array = dynamic_cast<const array_node *>(&before);
+                const auto after_array = dynamic_cast<const array_node *>(&after);
+                if (before_array != nullptr && after_array != nullptr) {
+                    compare_elements(*before_array, *after_array);
+                    return;
+                }
+
+                const auto before_literal = dynamic_cast<const literal_node *>(&before);
+                const auto after_literal = dynamic_cast<const literal_node *>(&after);
+                if (before_literal == nullptr || after_literal == nullptr
+                        || before_literal->get_value() != after_literal->get_value()) {
+                    report(change_kind::changed);
+                }
+            }
+
+        private:
+            void compare_members(const object_node &before, const object_node &after) {
+                const auto &old_members = before.get_children();
+                const auto &new_members = after.get_children();
+
+                // Members usually keep their order, so walk both lists in step as long as they agree
+                size_t common = 0;
+                const auto limit = std::min(old_members.size(), new_members.size());
+                for (; common < limit && old_members[common]->name_handle() == new_members[common]->name_handle(); common++) {
+                    compare_member(*old_members[common], *new_members[common]);
+                }
+                if (common == old_members.size() && common == new_members.size()) {
+                    return;
+                }
+
+                std::unordered_map<std::string_view, const node *> remaining;
+                remaining.reserve(new_members.size() - common);
+                for (size_t i = common; i < new_members.size(); i++) {
+                    remaining.emplace(new_members[i]->name(), new_members[i].get());
+                }
+                for (size_t i = common; i < old_members.size(); i++) {
+                    const auto &member = *old_members[i];
+                    const auto match = remaining.find(member.name());
+                    if (match == remaining.end()) {
+                        report_member(change_kind::removed, member.name());
+                    } else {
+                        compare_member(member, *match->second);
+                        remaining.erase(match);
+                    }
+                }
+                // In the order of the newer tree
+                for (size_t i = common; i < new_members.size(); i++) {
+                    if (remaining.contains(new_members[i]->name())) {
+                        report_member(change_kind::added, new_members[i]->name());
+                    }
+                }
+            }
+
+
+            void compare_elements(const array_node &before, const array_node &after) {
+                // Element by element, so columnar arrays are not built as a whole
+                const auto old_size = before.size();
+                const auto new_size = after.size();
+                const auto common = std::min(old_size, new_size);
+                for (size_t i = 0; i < common; i++) {
+                    const auto length = push_element(i);
+                    compare(*before.element(i), *after.element(i));
+                    path.resize(length);
+                }
+                for (size_t i = common; i < old_size; i++) {
+                    const auto length = push_element(i);
+                    report(change_kind::removed);
+                    path.resize(length);
+                }
+                for (size_t i = common; i < new_size; i++) {
+                    const auto length = push_element(i);
+                    report(change_kind::added);
+                    path.resize(length);
+                }
+            }
+
+
+            void compare_member(const node &before, const node &after) {
+                const auto length = push_member(before.name());
+                compare(before, after);
+                path.resize(length);
+            }
+
+
+            void report_member(change_kind kind, std::string_view name) {
+                const auto length = push_member(name);
+                report(kind);
+                path.resize(length);
+            }
+
+
+            void report(change_kind kind) {
+                changes.push_back({kind, path});
+            }
+
+
+            /**
+             * Extend the path by a member
+             * @return The length of the path before, to truncate it back to
+             */
+            size_t push_member(std::string_view name) {
+                const auto length = path.size();
+                if (length != 0) {
+                    path += '.';
+                }
+                path += name;
+                return length;
+            }
+
+
+            size_t push_element(size_t index) {
+                const auto length = path.size();
+                path += '[';
+                append_integer(path, static_cast<std::int64_t>(index));
+                path += ']';
+                return length;
+            }
+
+            std::vector<model_change> &changes;
+            std::string path;
+        };
+
+    }
+
+
+    std::vector<model_change> diff(const node &before, const node &after) {
+        std::vector<model_change> changes;
+        tree_differ(changes).compare(before, after);
+        return changes;
+    }
+
+}
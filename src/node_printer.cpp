@@ -1,34 +1,70 @@
-
 #include "vole/node_printer.hpp"
 
+#include <algorithm>
+
 namespace vole {
 
 
     std::string node_printer::render(const datamodel::node &node) {
-        renderer.clear();
+        std::string text;
+        string_sink target(text);
+        render(node, target);
+        return text;
+    }
+
+
+    void node_printer::render(const datamodel::node &node, output_sink &target) {
+        chunked_sink chunks(target);
+        sink = &chunks;
         node.apply(*this);
-        return renderer.str();
+        sink = nullptr;
+        chunks.drain();
     }
 
+
     void node_printer::on_enter(const datamodel::array_node &node) {
-        append(node.format_debug());
+        append("array_node", node.name());
     }
 
 
     void node_printer::on_enter(const datamodel::literal_node &node) {
-        append(node.format_debug());
+        // The names node::type() returns, without building a string for each node
+        static struct type_name_t {
+            std::string_view operator()(const datamodel::null_type&) {return "null";}
+            std::string_view operator()(const datamodel::string_type&) {return "string";}
+            std::string_view operator()(const datamodel::bool_type&) {return "bool";}
+            std::string_view operator()(const datamodel::num_type&) {return "num";}
+            std::string_view operator()(const datamodel::binary_type&) {return "binary";}
+        } type_name;
+        append(std::visit(type_name, node.get_value()), node.name());
     }
 
 
     void node_printer::on_enter(const datamodel::object_node &node) {
-        append(node.format_debug());
+        append("object_node", node.name());
     }
 
 
     void node_printer::append(std::string_view text) {
         constexpr size_t TAB_SIZE = 2;
-        renderer << std::string(get_depth() * TAB_SIZE, ' ') << text << '\n';
+        static constexpr std::string_view spaces = "                                ";
+        for (auto indent = get_depth() * TAB_SIZE; indent > 0; ) {
+            const auto step = std::min(indent, spaces.size());
+            sink->write(spaces.substr(0, step));
+            indent -= step;
+        }
+        sink->write(text);
+        sink->write('\n');
+    }
+
+
+    void node_printer::append(std::string_view type, std::string_view name) {
+        line.assign(type);
+        line += '{';
+        line += name;
+        line += '}';
+        append(std::string_view(line));
     }
 
 
-}
\ No newline at end of file
+}
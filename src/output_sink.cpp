@@ -0,0 +1,59 @@
+#include "vole/output_sink.hpp"
+
+#include <algorithm>
+
+namespace vole {
+
+    void string_sink::write(std::string_view text) {
+        target += text;
+    }
+
+
+    void stream_sink::write(std::string_view text) {
+        target.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+
+    void stream_sink::flush() {
+        target.flush();
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::chunked_sink
+     *
+     ************************************************************/
+
+
+    void chunked_sink::write(std::string_view text) {
+        if (used + text.size() > buffer.size()) {
+            if (used != 0) {
+                next.write(std::string_view(buffer.data(), used));
+                used = 0;
+            }
+            if (text.size() >= buffer.size()) {
+                // Too large to be worth copying
+                next.write(text);
+                return;
+            }
+        }
+        std::copy(text.begin(), text.end(), buffer.begin() + used);
+        used += text.size();
+    }
+
+
+    void chunked_sink::flush() {
+        drain();
+        next.flush();
+    }
+
+
+    void chunked_sink::drain() {
+        if (used != 0) {
+            next.write(std::string_view(buffer.data(), used));
+            used = 0;
+        }
+    }
+
+}
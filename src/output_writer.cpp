@@ -0,0 +1,127 @@
+#include "vole/output_writer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <fmt/format.h>
+
+#include <unistd.h>
+
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    void write_file_atomically(const std::filesystem::path &path, std::string_view content) {
+        write_file_atomically(path, [content](output_sink &sink) { sink.write(content); });
+    }
+
+
+    void write_file_atomically(const std::filesystem::path &path, content_producer produce) {
+        // Unique per process; the process id separates concurrent renderers
+        static std::atomic<std::uint64_t> sequence = 0;
+        auto temporary = path;
+        temporary += fmt::format(".{}.{}.tmp", ::getpid(), sequence++);
+
+        {
+            std::ofstream output(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!output.is_open()) {
+                throw std::system_error(errno, std::generic_category(),
+                    fmt::format("Failed to open {} for writing", temporary.string()));
+            }
+            try {
+                stream_sink sink(output);
+                produce(sink);
+            } catch (...) {
+                output.close();
+                std::filesystem::remove(temporary);
+                throw;
+            }
+            VOLE_PROFILE_COUNT(output_bytes, static_cast<std::uint64_t>(std::max<std::streamoff>(output.tellp(), 0)));
+            output.close();
+            if (!output) {
+                const auto error = errno;
+                std::filesystem::remove(temporary);
+                throw std::system_error(error, std::generic_category(),
+                    fmt::format("Failed to write {}", path.string()));
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary);
+            throw std::system_error(error, fmt::format("Failed to replace {}", path.string()));
+        }
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::output_writer
+     *
+     ************************************************************/
+
+
+    output_writer::output_writer(size_t threads)
+        : pool(threads)
+    {}
+
+
+    void output_writer::write(std::filesystem::path path, std::string content) {
+        {
+            std::lock_guard lock(mutex);
+            pending++;
+        }
+        // Failures are reported through wait(), so the future is not needed
+        static_cast<void>(pool.submit([this, path = std::move(path), content = std::move(content)] {
+            content_producer produce = [&content](output_sink &sink) { sink.write(content); };
+            write_reporting(path, produce);
+
+            std::lock_guard lock(mutex);
+            if (--pending == 0) {
+                idle.notify_all();
+            }
+        }));
+    }
+
+
+    void output_writer::write(const std::filesystem::path &path, content_producer produce) {
+        write_reporting(path, produce);
+    }
+
+
+    void output_writer::write_reporting(const std::filesystem::path &path, content_producer &produce) {
+        try {
+            write_now(path, produce);
+        } catch (std::exception &e) {
+            std::lock_guard lock(mutex);
+            failures.push_back(write_failure{path, e.what()});
+        }
+    }
+
+
+    std::vector<write_failure> output_writer::wait() {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+        return std::exchange(failures, {});
+    }
+
+
+    void output_writer::write_now(const std::filesystem::path &path, content_producer &produce) {
+        VOLE_PROFILE_ZONE("write output");
+        const auto directory = path.parent_path();
+        if (!directory.empty()) {
+            // Held while creating, so concurrent writes into a new directory create it once
+            std::lock_guard lock(directories_mutex);
+            if (!created_directories.contains(directory.string())) {
+                std::filesystem::create_directories(directory);
+                created_directories.insert(directory.string());
+            }
+        }
+        write_file_atomically(path, std::move(produce));
+    }
+
+}
@@ -0,0 +1,313 @@
+#include "vole/parallel_traversal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "vole/thread_pool.hpp"
+
+namespace vole::datamodel {
+
+    namespace {
+
+        /**
+         * A range of children of one array or object, all at the same depth
+         */
+        struct traversal_task {
+            // Keeps the parent alive if it was built for the traversal only,
+            // as the elements of columnar arrays are
+            shared_node owner;
+            const node *parent;
+            detail::tree_position position;
+            size_t begin;
+            size_t end;
+            size_t depth;
+        };
+
+        // Ranges up to this size are visited without splitting them further
+        constexpr size_t task_grain = 64;
+
+        size_t child_count(const node &node) {
+            if (const auto array = dynamic_cast<const array_node *>(&node)) {
+                return array->size();
+            }
+            if (const auto object = dynamic_cast<const object_node *>(&node)) {
+                return object->get_children().size();
+            }
+            return 0;
+        }
+
+
+        /**
+         * The scheduler shared by the workers of one traversal. Each worker
+         * owns a queue: it pushes and pops work at the back, while idle
+         * workers steal the oldest, and thus usually largest, work from the
+         * front of other queues.
+         */
+        class traversal {
+        public:
+            traversal(size_t workers, detail::traversal_callback &callback)
+                : queues(workers), callback(callback) {}
+
+            void push(size_t worker, traversal_task task) {
+                pending.fetch_add(1, std::memory_order_relaxed);
+                {
+                    std::lock_guard lock(queues[worker].mutex);
+                    queues[worker].tasks.push_back(std::move(task));
+                }
+                signal.fetch_add(1, std::memory_order_release);
+                signal.notify_one();
+            }
+
+            void run(size_t worker) {
+                traversal_task task;
+                while (!failed.load(std::memory_order_relaxed)) {
+                    // Read before looking for work, so a push in between ends the wait right away
+                    const auto seen = signal.load(std::memory_order_acquire);
+                    if (!pop(worker, task) && !steal(worker, task)) {
+                        if (pending.load(std::memory_order_acquire) == 0) {
+                            return;
+                        }
+                        signal.wait(seen, std::memory_order_acquire);
+                        continue;
+                    }
+                    try {
+                        process(worker, std::move(task));
+                    } catch (...) {
+                        {
+                            std::lock_guard lock(error_mutex);
+                            if (!error) {
+                                error = std::current_exception();
+                            }
+                        }
+                        failed = true;
+                        wake_all();
+                    }
+                    // Only after the children were pushed, so pending cannot drop to zero early
+                    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        wake_all();
+                    }
+                }
+            }
+
+            void rethrow() const {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+        private:
+            struct worker_queue {
+                std::mutex mutex;
+                std::deque<traversal_task> tasks;
+            };
+
+            void wake_all() {
+                signal.fetch_add(1, std::memory_order_release);
+                signal.notify_all();
+            }
+
+            bool pop(size_t worker, traversal_task &task) {
+                auto &queue = queues[worker];
+                std::lock_guard lock(queue.mutex);
+                if (queue.tasks.empty()) {
+                    return false;
+                }
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return true;
+            }
+
+            bool steal(size_t worker, traversal_task &task) {
+                for (size_t i = 1; i < queues.size(); i++) {
+                    auto &queue = queues[(worker + i) % queues.size()];
+                    std::lock_guard lock(queue.mutex);
+                    if (!queue.tasks.empty()) {
+                        task = std::move(queue.tasks.front());
+                        queue.tasks.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void process(size_t worker, traversal_task task) {
+                // Leave the upper halves of large ranges for others to steal
+                while (task.end - task.begin > task_grain && queues.size() > 1) {
+                    const auto middle = task.begin + (task.end - task.begin) / 2;
+                    push(worker, {task.owner, task.parent, task.position, middle, task.end, task.depth});
+                    task.end = middle;
+                }
+                // A part ends where a subtree is left to another task, which continues the pre-order
+                auto part = task.position;
+                part.push_back(task.begin);
+                callback.begin_part(worker, part);
+                // Arrays hand out their elements one by one, so columnar arrays are not built as a whole
+                const auto array = dynamic_cast<const array_node *>(task.parent);
+                for (auto i = task.begin; i < task.end; i++) {
+                    shared_node element;
+                    const node *child = nullptr;
+                    if (array != nullptr) {
+                        element = array->element(i);
+                        child = element.get();
+                    } else {
+                        child = static_cast<const object_node &>(*task.parent).get_children()[i].get();
+                    }
+                    callback.visit(worker, *child, task.depth);
+                    if (const auto count = child_count(*child); count != 0) {
+                        auto position = task.position;
+                        position.push_back(i);
+                        push(worker, {std::move(element), child, std::move(position), 0, count, task.depth + 1});
+                        if (i + 1 < task.end) {
+                            part.back() = i + 1;
+                            callback.begin_part(worker, part);
+                        }
+                    }
+                }
+            }
+
+            // Constructed once with one queue per worker and never resized
+            std::deque<worker_queue> queues;
+            detail::traversal_callback &callback;
+            std::atomic<size_t> pending = 0;
+            // Bumped whenever there may be new work, or when the traversal ends. Idle workers wait on it.
+            std::atomic<std::uint32_t> signal = 0;
+            std::atomic<bool> failed = false;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+        };
+
+    }
+
+
+    size_t detail::traversal_workers(size_t threads) {
+        return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+
+    namespace {
+
+        thread_pool &helper_pool() {
+            static thread_pool pool;
+            return pool;
+        }
+
+
+        /**
+         * Lets the caller of a traversal finish without waiting for helpers
+         * which have not started yet, e.g. because the pool is busy with
+         * other traversals. Those find the traversal closed and return.
+         */
+        struct helper_gate {
+            std::mutex mutex;
+            std::condition_variable idle;
+            bool closed = false;
+            size_t running = 0;
+        };
+
+    }
+
+
+    void detail::run_traversal(const node &root, size_t threads, traversal_callback &callback) {
+        const auto workers = traversal_workers(threads);
+        callback.begin_part(0, {});
+        callback.visit(0, root, 0);
+        const auto count = child_count(root);
+        if (count == 0) {
+            return;
+        }
+
+        traversal scheduler(workers, callback);
+        scheduler.push(0, {nullptr, &root, {}, 0, count, 1});
+        const auto gate = std::make_shared<helper_gate>();
+        for (size_t worker = 1; worker < workers; worker++) {
+            // The future is not needed: helpers report failures through the scheduler
+            (void)helper_pool().submit([gate, scheduler = &scheduler, worker] {
+                {
+                    std::lock_guard lock(gate->mutex);
+                    if (gate->closed) {
+                        return;
+                    }
+                    gate->running++;
+                }
+                scheduler->run(worker);
+                std::lock_guard lock(gate->mutex);
+                if (--gate->running == 0) {
+                    gate->idle.notify_all();
+                }
+            });
+        }
+        scheduler.run(0);
+        {
+            std::unique_lock lock(gate->mutex);
+            gate->closed = true;
+            gate->idle.wait(lock, [&gate] { return gate->running == 0; });
+        }
+        scheduler.rethrow();
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::datamodel::parallel_descender
+     *
+     ************************************************************/
+
+
+    namespace {
+
+        // The position of the calling worker during descend_parallel()
+        thread_local const parallel_descender *active_descender = nullptr;
+        thread_local size_t active_depth = 0;
+        thread_local size_t active_worker = 0;
+
+    }
+
+
+    void parallel_descender::descend_parallel(const node &root, size_t threads) {
+        class callback_t : public detail::traversal_callback {
+        public:
+            explicit callback_t(parallel_descender &descender)
+                : descender(descender) {}
+
+            void visit(size_t worker, const node &node, size_t depth) override {
+                active_descender = &descender;
+                active_depth = depth;
+                active_worker = worker;
+                if (const auto array = dynamic_cast<const array_node *>(&node)) {
+                    descender.on_enter(*array);
+                } else if (const auto object = dynamic_cast<const object_node *>(&node)) {
+                    descender.on_enter(*object);
+                } else if (const auto literal = dynamic_cast<const literal_node *>(&node)) {
+                    descender.on_enter(*literal);
+                }
+                active_descender = nullptr;
+            }
+
+        private:
+            parallel_descender &descender;
+        };
+
+        on_start(detail::traversal_workers(threads));
+        callback_t callback(*this);
+        detail::run_traversal(root, threads, callback);
+    }
+
+
+    size_t parallel_descender::get_depth() const {
+        return active_descender == this ? active_depth : node_descender::get_depth();
+    }
+
+
+    size_t parallel_descender::get_worker() const {
+        return active_descender == this ? active_worker : 0;
+    }
+
+}
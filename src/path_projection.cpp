@@ -0,0 +1,181 @@
+#include "vole/path_projection.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+
+namespace vole::datamodel {
+
+    /************************************************************
+     *
+     *                  vole::datamodel::path_projection
+     *
+     ************************************************************/
+
+
+    path_projection::path_projection()
+        : steps(1)
+    {}
+
+
+    path_projection::path_projection(const std::vector<std::string> &paths)
+        : path_projection()
+    {
+        for (const auto &path : paths) {
+            add_path(path);
+        }
+    }
+
+
+    void path_projection::add_path(std::string_view path) {
+        size_t current = 0;
+        size_t pos = 0;
+        bool expect_name = true;
+
+        while (pos < path.size()) {
+            if (path[pos] == '[') {
+                const auto close = path.find(']', pos);
+                if (close == std::string_view::npos) {
+                    throw syntax_exception(
+                        fmt::format("Unterminated '[' at offset {} of path '{}'", pos, path));
+                }
+                const auto index_text = path.substr(pos + 1, close - pos - 1);
+                if (index_text == "*") {
+                    current = add_any_step(current);
+                } else {
+                    size_t index = 0;
+                    const auto [end, error] = std::from_chars(
+                        index_text.data(), index_text.data() + index_text.size(), index);
+                    if (error != std::errc() || end != index_text.data() + index_text.size()) {
+                        throw syntax_exception(
+                            fmt::format("Invalid array index '{}' in path '{}'", index_text, path));
+                    }
+                    current = add_element_step(current, index);
+                }
+                pos = close + 1;
+                expect_name = false;
+            } else if (path[pos] == '.' && !expect_name) {
+                pos++;
+                expect_name = true;
+            } else if (expect_name) {
+                const auto end = std::min(path.find_first_of(".[", pos), path.size());
+                const auto name = path.substr(pos, end - pos);
+                if (name.empty()) {
+                    throw syntax_exception(
+                        fmt::format("Expected a name at offset {} of path '{}'", pos, path));
+                }
+                current = (name == "*") ? add_any_step(current) : add_member_step(current, name);
+                pos = end;
+                expect_name = false;
+            } else {
+                throw syntax_exception(
+                    fmt::format("Unexpected '{}' at offset {} of path '{}'", path[pos], pos, path));
+            }
+        }
+
+        if (expect_name && !path.empty()) {
+            throw syntax_exception(fmt::format("Path '{}' must not end with '.'", path));
+        }
+        steps[current].terminal = true;
+    }
+
+
+    path_projection::selection path_projection::root() const {
+        selection result;
+        advance(result, 0);
+        return result;
+    }
+
+
+    path_projection::selection path_projection::select_member(
+            const selection &parent, std::string_view name) const {
+        if (parent.whole) {
+            return parent;
+        }
+        selection result;
+        for (const auto from : parent.steps) {
+            const auto &current = steps[from];
+            if (const auto member = current.members.find(name); member != current.members.end()) {
+                advance(result, member->second);
+            }
+            if (current.any != 0) {
+                advance(result, current.any);
+            }
+        }
+        return result;
+    }
+
+
+    path_projection::selection path_projection::select_element(
+            const selection &parent, size_t index) const {
+        if (parent.whole) {
+            return parent;
+        }
+        selection result;
+        for (const auto from : parent.steps) {
+            const auto &current = steps[from];
+            if (const auto element = current.elements.find(index); element != current.elements.end()) {
+                advance(result, element->second);
+            }
+            if (current.any != 0) {
+                advance(result, current.any);
+            }
+        }
+        return result;
+    }
+
+
+    bool path_projection::selects_later_element(const selection &parent, size_t index) const {
+        if (parent.whole) {
+            return true;
+        }
+        return std::any_of(parent.steps.begin(), parent.steps.end(), [&](size_t from) {
+            const auto &elements = steps[from].elements;
+            return steps[from].any != 0 || elements.upper_bound(index) != elements.end();
+        });
+    }
+
+
+    size_t path_projection::add_member_step(size_t from, std::string_view name) {
+        if (const auto existing = steps[from].members.find(name); existing != steps[from].members.end()) {
+            return existing->second;
+        }
+        steps.emplace_back();
+        const auto to = steps.size() - 1;
+        steps[from].members.emplace(std::string(name), to);
+        return to;
+    }
+
+
+    size_t path_projection::add_element_step(size_t from, size_t index) {
+        if (const auto existing = steps[from].elements.find(index); existing != steps[from].elements.end()) {
+            return existing->second;
+        }
+        steps.emplace_back();
+        const auto to = steps.size() - 1;
+        steps[from].elements.emplace(index, to);
+        return to;
+    }
+
+
+    size_t path_projection::add_any_step(size_t from) {
+        if (steps[from].any == 0) {
+            steps.emplace_back();
+            steps[from].any = steps.size() - 1;
+        }
+        return steps[from].any;
+    }
+
+
+    void path_projection::advance(selection &result, size_t to) const {
+        if (steps[to].terminal) {
+            result.whole = true;
+            result.steps.clear();
+        } else if (!result.whole) {
+            result.steps.push_back(to);
+        }
+    }
+
+}
@@ -0,0 +1,366 @@
+#include "vole/profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+namespace vole {
+
+    namespace {
+
+        using profile_clock = std::chrono::steady_clock;
+        using counter_values = std::array<std::uint64_t, 3>;
+
+        struct open_zone {
+            // Interned, see intern()
+            const std::string *label;
+            std::source_location where;
+            // Interned, or null for zones outside of templates
+            const std::string *template_file;
+            size_t template_offset;
+            counter_values counters{};
+            profile_clock::duration children{};
+            profile_clock::time_point start;
+        };
+
+        struct zone_record {
+            const std::string *label;
+            std::source_location where;
+            const std::string *template_file;
+            size_t template_offset;
+            // The number of zones which were open around this one
+            size_t depth;
+            counter_values counters;
+            profile_clock::time_point start;
+            profile_clock::duration duration;
+            profile_clock::duration self;
+        };
+
+        /**
+         * The zones completed on one thread. Only locked by its own thread
+         * and by the writers, so recording does not contend.
+         */
+        struct thread_buffer {
+            explicit thread_buffer(size_t id) : id(id) {}
+
+            const size_t id;
+            std::mutex mutex;
+            std::vector<zone_record> records;
+        };
+
+        struct profile_registry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<thread_buffer>> buffers;
+            profile_clock::time_point epoch = profile_clock::now();
+            // The offsets at which the lines of each registered template start
+            std::map<std::string, std::vector<size_t>, std::less<>> template_lines;
+
+            // Interned texts are never released, so records and caches may point at them
+            std::mutex names_mutex;
+            std::unordered_set<std::string> names;
+        };
+
+        profile_registry &registry() {
+            static profile_registry instance;
+            return instance;
+        }
+
+        struct thread_state {
+            std::vector<open_zone> open;
+            std::shared_ptr<thread_buffer> buffer;
+            // The texts this thread interned before, looked up without locking
+            std::unordered_map<std::string_view, const std::string *> names;
+        };
+
+        thread_local thread_state current;
+
+
+        thread_buffer &local_buffer() {
+            if (current.buffer == nullptr) {
+                auto &profiles = registry();
+                std::lock_guard lock(profiles.mutex);
+                current.buffer = std::make_shared<thread_buffer>(profiles.buffers.size() + 1);
+                profiles.buffers.push_back(current.buffer);
+            }
+            return *current.buffer;
+        }
+
+
+        /**
+         * Get the one stored copy of a text. ';' separates the frames of
+         * folded stacks, so it is replaced in the copy.
+         */
+        const std::string *intern(std::string_view text) {
+            if (const auto known = current.names.find(text); known != current.names.end()) {
+                return known->second;
+            }
+            std::string stored(text);
+            std::replace(stored.begin(), stored.end(), ';', ':');
+            auto &profiles = registry();
+            const std::string *interned = nullptr;
+            {
+                std::lock_guard lock(profiles.names_mutex);
+                interned = &*profiles.names.insert(std::move(stored)).first;
+            }
+            // Replaced texts are looked up in the registry every time, as there is no copy to key the cache by
+            if (text == *interned) {
+                current.names.emplace(*interned, interned);
+            }
+            return interned;
+        }
+
+
+        /**
+         * Call a function for every recorded zone with the id of its thread
+         * and the start of the recording
+         */
+        template <typename Function>
+        void for_each_record(Function &&function) {
+            auto &profiles = registry();
+            std::lock_guard lock(profiles.mutex);
+            for (const auto &buffer : profiles.buffers) {
+                std::lock_guard buffer_lock(buffer->mutex);
+                for (const auto &record : buffer->records) {
+                    function(buffer->id, record, profiles.epoch);
+                }
+            }
+        }
+
+
+        /**
+         * Where a zone's time is attributed to: `file:line:column` of its
+         * template section, or `file:line` of vole's code. Only called by
+         * the writers, which hold the registry lock.
+         */
+        std::string location_of(const zone_record &record) {
+            if (record.template_file == nullptr) {
+                return fmt::format("{}:{}", record.where.file_name(), record.where.line());
+            }
+            const auto &lines = registry().template_lines;
+            const auto known = lines.find(*record.template_file);
+            if (known == lines.end()) {
+                return fmt::format("{}@{}", *record.template_file, record.template_offset);
+            }
+            const auto &starts = known->second;
+            const auto line = static_cast<size_t>(
+                std::upper_bound(starts.begin(), starts.end(), record.template_offset) - starts.begin());
+            return fmt::format("{}:{}:{}", *record.template_file, line, record.template_offset - starts[line - 1] + 1);
+        }
+
+
+        /**
+         * The name of a zone as a frame of a folded stack
+         */
+        std::string frame_of(const zone_record &record) {
+            return record.template_file == nullptr ? *record.label
+                : fmt::format("{} ({})", *record.label, location_of(record));
+        }
+
+
+        double to_microseconds(profile_clock::duration duration) {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        }
+
+        constexpr std::array counter_names = {"iterations", "lookups", "output_bytes"};
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::profiler
+     *
+     ************************************************************/
+
+
+    void profiler::enable() {
+        // Creating the registry starts the clock of the recording
+        static_cast<void>(registry());
+        active = true;
+    }
+
+
+    void profiler::disable() {
+        active = false;
+    }
+
+
+    void profiler::reset() {
+        auto &profiles = registry();
+        std::lock_guard lock(profiles.mutex);
+        for (const auto &buffer : profiles.buffers) {
+            std::lock_guard buffer_lock(buffer->mutex);
+            buffer->records.clear();
+        }
+        profiles.epoch = profile_clock::now();
+    }
+
+
+    void profiler::register_template(std::string_view file, std::string_view source) {
+        std::vector<size_t> starts{0};
+        for (auto line_break = source.find('\n'); line_break != std::string_view::npos;
+                line_break = source.find('\n', line_break + 1)) {
+            starts.push_back(line_break + 1);
+        }
+        auto &profiles = registry();
+        std::lock_guard lock(profiles.mutex);
+        profiles.template_lines.insert_or_assign(std::string(file), std::move(starts));
+    }
+
+
+    void profiler::write_trace(std::ostream &out) {
+        out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+        bool first = true;
+        for_each_record([&out, &first](size_t thread, const zone_record &record, profile_clock::time_point epoch) {
+            nlohmann::json arguments = {
+                {"location", location_of(record)},
+                {"function", record.where.function_name()},
+            };
+            for (size_t i = 0; i < counter_names.size(); i++) {
+                if (record.counters[i] != 0) {
+                    arguments[counter_names[i]] = record.counters[i];
+                }
+            }
+            const nlohmann::json event = {
+                {"name", *record.label},
+                {"cat", "vole"},
+                {"ph", "X"},
+                {"pid", 1},
+                {"tid", thread},
+                {"ts", to_microseconds(record.start - epoch)},
+                {"dur", to_microseconds(record.duration)},
+                {"args", std::move(arguments)},
+            };
+            out << (first ? "\n" : ",\n") << event.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            first = false;
+        });
+        out << "\n]}\n";
+    }
+
+
+    void profiler::write_folded(std::ostream &out) {
+        std::map<std::string, profile_clock::duration> stacks;
+        auto &profiles = registry();
+        std::lock_guard lock(profiles.mutex);
+        for (const auto &buffer : profiles.buffers) {
+            std::lock_guard buffer_lock(buffer->mutex);
+            // Stacks are rebuilt here instead of while recording: in order of
+            // their start, each zone is nested in the last one of lower depth
+            std::vector<const zone_record *> records;
+            records.reserve(buffer->records.size());
+            for (const auto &record : buffer->records) {
+                records.push_back(&record);
+            }
+            std::sort(records.begin(), records.end(), [](const auto *a, const auto *b) {
+                return std::tie(a->start, a->depth) < std::tie(b->start, b->depth);
+            });
+            std::vector<size_t> frame_ends;
+            std::string stack;
+            for (const auto *record : records) {
+                const auto depth = std::min(record->depth, frame_ends.size());
+                frame_ends.resize(depth);
+                stack.resize(depth == 0 ? 0 : frame_ends.back());
+                if (depth != 0) {
+                    stack += ';';
+                }
+                stack += frame_of(*record);
+                frame_ends.push_back(stack.size());
+                stacks[stack] += record->self;
+            }
+        }
+        for (const auto &[stack, self] : stacks) {
+            out << stack << ' ' << std::chrono::duration_cast<std::chrono::microseconds>(self).count() << '\n';
+        }
+    }
+
+
+    void profiler::write_summary(std::ostream &out) {
+        struct location_summary {
+            size_t calls = 0;
+            profile_clock::duration total{};
+            profile_clock::duration self{};
+            counter_values counters{};
+        };
+        // Keyed by label and location
+        std::map<std::pair<std::string, std::string>, location_summary> locations;
+        for_each_record([&locations](size_t, const zone_record &record, profile_clock::time_point) {
+            auto &summary = locations[{*record.label, location_of(record)}];
+            summary.calls++;
+            summary.total += record.duration;
+            summary.self += record.self;
+            for (size_t i = 0; i < summary.counters.size(); i++) {
+                summary.counters[i] += record.counters[i];
+            }
+        });
+
+        std::vector<std::pair<decltype(locations)::key_type, location_summary>> rows(locations.begin(), locations.end());
+        std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second.self > b.second.self; });
+
+        out << fmt::format("{:>10} {:>12} {:>12} {:>12} {:>12} {:>14}  {}\n",
+            "calls", "total ms", "self ms", "iterations", "lookups", "output bytes", "zone");
+        for (const auto &[key, summary] : rows) {
+            const auto &[label, location] = key;
+            out << fmt::format("{:>10} {:>12.3f} {:>12.3f} {:>12} {:>12} {:>14}  {} ({})\n",
+                summary.calls, to_microseconds(summary.total) / 1000, to_microseconds(summary.self) / 1000,
+                summary.counters[0], summary.counters[1], summary.counters[2], label, location);
+        }
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::profile_zone
+     *
+     ************************************************************/
+
+
+    void profile_zone::begin(std::string_view label, const std::source_location &where,
+                             const template_location *in_template) {
+        current.open.push_back({
+            .label = intern(label),
+            .where = where,
+            .template_file = in_template == nullptr ? nullptr : intern(in_template->file),
+            .template_offset = in_template == nullptr ? 0 : in_template->offset,
+            .counters = {},
+            .children = {},
+            .start = {},
+        });
+        open = true;
+        current.open.back().start = profile_clock::now();
+    }
+
+
+    void profile_zone::end() {
+        const auto finished = profile_clock::now();
+        const auto zone = current.open.back();
+        current.open.pop_back();
+        const auto duration = finished - zone.start;
+        if (!current.open.empty()) {
+            current.open.back().children += duration;
+        }
+
+        auto &buffer = local_buffer();
+        std::lock_guard lock(buffer.mutex);
+        buffer.records.push_back({
+            zone.label, zone.where, zone.template_file, zone.template_offset, current.open.size(),
+            zone.counters, zone.start, duration, duration - zone.children,
+        });
+    }
+
+
+    void profile_count(profile_counter counter, std::uint64_t amount) {
+        if (profiler::enabled() && !current.open.empty()) {
+            current.open.back().counters[static_cast<size_t>(counter)] += amount;
+        }
+    }
+
+}
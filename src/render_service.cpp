@@ -0,0 +1,564 @@
+#include "render_service.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <map>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <vole/node_printer.hpp>
+#include <vole/output_writer.hpp>
+#include <vole/profiler.hpp>
+#include <vole/thread_pool.hpp>
+
+namespace vole::renderer {
+
+    namespace {
+
+        /**
+         * Owns a file descriptor and closes it on destruction
+         */
+        class fd_handle {
+        public:
+            explicit fd_handle(int fd) : fd(fd) {}
+            fd_handle(const fd_handle &) = delete;
+            fd_handle &operator=(const fd_handle &) = delete;
+            fd_handle(fd_handle &&other) noexcept : fd(std::exchange(other.fd, -1)) {}
+            fd_handle &operator=(fd_handle &&other) noexcept {
+                std::swap(fd, other.fd);
+                return *this;
+            }
+            ~fd_handle() {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+
+            [[nodiscard]] int get() const {
+                return fd;
+            }
+
+        private:
+            int fd;
+        };
+
+
+        [[noreturn]] void throw_errno(std::string_view what) {
+            throw std::system_error(errno, std::generic_category(), std::string(what));
+        }
+
+
+        sockaddr_un make_address(const std::filesystem::path &socket_path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            const auto path = socket_path.string();
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error(fmt::format("Socket path {} is too long", path));
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+
+        void write_line(int fd, const std::string &text) {
+            const auto line = text + '\n';
+            size_t written = 0;
+            while (written < line.size()) {
+                const auto result = ::send(fd, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw_errno("Failed to write to socket");
+                }
+                written += static_cast<size_t>(result);
+            }
+        }
+
+
+        std::string read_line(int fd) {
+            std::string line;
+            char buffer[4096];
+            while (true) {
+                const auto result = ::recv(fd, buffer, sizeof(buffer), 0);
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw_errno("Failed to read from socket");
+                }
+                if (result == 0) {
+                    return line;
+                }
+                line.append(buffer, static_cast<size_t>(result));
+                if (const auto end = line.find('\n'); end != std::string::npos) {
+                    line.resize(end);
+                    return line;
+                }
+            }
+        }
+
+
+        // How long a client may take to send its request, and how long a send to it may block
+        constexpr std::chrono::seconds request_timeout{5};
+        // Requests only name files, anything longer is not a request
+        constexpr size_t max_request_size = 1024 * 1024;
+
+
+        /**
+         * A connection whose request has not been read completely yet
+         */
+        struct pending_request {
+            fd_handle connection;
+            std::string line;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+
+        /**
+         * Read what a client has sent so far
+         * @return Whether the request is complete. Throws if the client went
+         *         away or sent more than a request may be long.
+         */
+        bool read_request(pending_request &request) {
+            char buffer[4096];
+            const auto result = ::recv(request.connection.get(), buffer, sizeof(buffer), 0);
+            if (result < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return false;
+                }
+                throw_errno("Failed to read from socket");
+            }
+            if (result == 0) {
+                throw std::runtime_error("Connection closed before the request was complete");
+            }
+            request.line.append(buffer, static_cast<size_t>(result));
+            if (const auto end = request.line.find('\n'); end != std::string::npos) {
+                request.line.resize(end);
+                return true;
+            }
+            if (request.line.size() > max_request_size) {
+                throw std::runtime_error("Request too long");
+            }
+            return false;
+        }
+
+
+        void set_timeout(int fd, int option, std::chrono::seconds timeout) {
+            const timeval value{static_cast<time_t>(timeout.count()), 0};
+            if (::setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value)) < 0) {
+                throw_errno("Failed to set socket timeout");
+            }
+        }
+
+
+        /**
+         * Make the socket path available for a new server. A socket left
+         * behind by a server which is gone is removed, a live one is not.
+         */
+        void claim_socket_path(const std::filesystem::path &socket_path, const sockaddr_un &address) {
+            const auto existing = std::filesystem::symlink_status(socket_path);
+            if (!std::filesystem::exists(existing)) {
+                return;
+            }
+            if (!std::filesystem::is_socket(existing)) {
+                throw std::runtime_error(fmt::format("{} exists and is not a socket", socket_path.string()));
+            }
+            fd_handle probe(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if (probe.get() < 0) {
+                throw_errno("Failed to create socket");
+            }
+            if (::connect(probe.get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0) {
+                throw std::runtime_error(fmt::format("A server is already listening on {}", socket_path.string()));
+            }
+            if (errno != ECONNREFUSED) {
+                throw_errno(fmt::format("Failed to probe {}", socket_path.string()));
+            }
+            std::filesystem::remove(socket_path);
+        }
+
+
+        nlohmann::json to_json(const render_job &job) {
+            nlohmann::json request = {{"command", "render"}, {"model", job.model.string()}};
+            if (job.format.has_value()) {
+                request["format"] = datamodel::format_name(job.format.value());
+            }
+            if (job.output.has_value()) {
+                request["output"] = job.output->string();
+            }
+            for (const auto &mount : job.mounts) {
+                nlohmann::json entry = {
+                    {"path", mount.path},
+                    {"file", mount.file.string()},
+                    {"merge", mount.mode == mount_mode::merge},
+                };
+                if (mount.format.has_value()) {
+                    entry["format"] = datamodel::format_name(mount.format.value());
+                }
+                request["mounts"].push_back(std::move(entry));
+            }
+            return request;
+        }
+
+
+        render_job from_json(const nlohmann::json &request) {
+            render_job job;
+            job.model = request.at("model").get<std::string>();
+            if (request.contains("format")) {
+                job.format = datamodel::format_from_name(request["format"].get<std::string>());
+            }
+            if (request.contains("output")) {
+                job.output = request["output"].get<std::string>();
+            }
+            for (const auto &entry : request.value("mounts", nlohmann::json::array())) {
+                model_mount mount;
+                mount.path = entry.at("path").get<std::string>();
+                mount.file = entry.at("file").get<std::string>();
+                mount.mode = entry.value("merge", false) ? mount_mode::merge : mount_mode::replace;
+                if (entry.contains("format")) {
+                    mount.format = datamodel::format_from_name(entry["format"].get<std::string>());
+                }
+                job.mounts.push_back(std::move(mount));
+            }
+            return job;
+        }
+
+
+        std::string dump(const nlohmann::json &message) {
+            return message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        }
+
+
+        nlohmann::json send_request(const std::filesystem::path &socket_path, const nlohmann::json &request) {
+            fd_handle connection(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if (connection.get() < 0) {
+                throw_errno("Failed to create socket");
+            }
+            const auto address = make_address(socket_path);
+            if (::connect(connection.get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+                throw_errno(fmt::format("Failed to connect to {}", socket_path.string()));
+            }
+            write_line(connection.get(), dump(request));
+            const auto response = nlohmann::json::parse(read_line(connection.get()));
+            if (response.at("status") != "ok") {
+                throw std::runtime_error(response.value("message", "Unknown server error"));
+            }
+            return response;
+        }
+
+    }
+
+
+    datamodel::frozen_document load_model(model_cache &cache, const render_job &job) {
+        return job.mounts.empty() ? cache.get(job.model, job.format) : compose_models(job.mounts, cache);
+    }
+
+
+    void render_model(const datamodel::frozen_document &document, output_sink &sink) {
+        VOLE_PROFILE_ZONE("render model");
+        node_printer renderer;
+        renderer.render(document.root(), sink);
+        sink.flush();
+    }
+
+
+    namespace {
+
+        /**
+         * Render the model of a job into the job's output file, or into the returned text
+         */
+        std::string deliver(const render_job &job, const datamodel::frozen_document &document) {
+            if (job.output.has_value()) {
+                write_file_atomically(job.output.value(), [&document](output_sink &sink) { render_model(document, sink); });
+                return {};
+            }
+
+            std::string text;
+            string_sink sink(text);
+            render_model(document, sink);
+            VOLE_PROFILE_COUNT(output_bytes, text.size());
+            return text;
+        }
+
+    }
+
+
+    std::string run_job(model_cache &cache, const render_job &job) {
+        VOLE_PROFILE_ZONE("render job");
+        return deliver(job, load_model(cache, job));
+    }
+
+
+    void watch(model_cache &cache, const std::vector<render_job> &jobs, const watch_report &report,
+               std::stop_token stop) {
+        fd_handle notifier(::inotify_init1(IN_CLOEXEC));
+        if (notifier.get() < 0) {
+            throw_errno("Failed to initialize inotify");
+        }
+        // Polled next to the notifier, so a stop request ends a wait for events
+        fd_handle stopped(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (stopped.get() < 0) {
+            throw_errno("Failed to create eventfd");
+        }
+        const std::stop_callback on_stop(stop, [&stopped] {
+            const std::uint64_t one = 1;
+            (void)::write(stopped.get(), &one, sizeof(one));
+        });
+
+        // Editors often save by renaming a new file over the old one, which
+        // ends watches on the file itself, so the directories are watched instead
+        std::unordered_map<int, std::filesystem::path> directories;
+        std::map<std::filesystem::path, std::vector<size_t>> dependents;
+        std::vector<std::shared_ptr<const datamodel::node>> rendered(jobs.size());
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const auto model = std::filesystem::absolute(jobs[i].model).lexically_normal();
+            dependents[model].push_back(i);
+            const int watch = ::inotify_add_watch(notifier.get(), model.parent_path().c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0) {
+                throw_errno(fmt::format("Failed to watch {}", model.parent_path().string()));
+            }
+            directories.emplace(watch, model.parent_path());
+            try {
+                rendered[i] = cache.get(jobs[i].model, jobs[i].format).get_root();
+            } catch (const std::exception &) {
+                // Reported by the initial rendering, rendered again once the file changes
+            }
+        }
+
+        alignas(inotify_event) char buffer[16 * 1024];
+        std::set<size_t> changed;
+        auto read_events = [&] {
+            const auto length = ::read(notifier.get(), buffer, sizeof(buffer));
+            if (length < 0) {
+                if (errno == EINTR) {
+                    return;
+                }
+                throw_errno("Failed to read file events");
+            }
+            for (ssize_t offset = 0; offset < length; ) {
+                const auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                const auto directory = directories.find(event->wd);
+                if (event->len == 0 || directory == directories.end()) {
+                    continue;
+                }
+                const auto jobs_of_file = dependents.find(directory->second / event->name);
+                if (jobs_of_file != dependents.end()) {
+                    changed.insert(jobs_of_file->second.begin(), jobs_of_file->second.end());
+                }
+            }
+        };
+
+        std::array<pollfd, 2> waiting{pollfd{notifier.get(), POLLIN, 0}, pollfd{stopped.get(), POLLIN, 0}};
+        while (!stop.stop_requested()) {
+            if (::poll(waiting.data(), waiting.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw_errno("Failed to wait for file events");
+            }
+            if ((waiting[0].revents & POLLIN) == 0) {
+                continue;
+            }
+            read_events();
+            // A save often consists of several events, collect them before rendering
+            pollfd pending{notifier.get(), POLLIN, 0};
+            while (!stop.stop_requested() && ::poll(&pending, 1, 10) > 0) {
+                read_events();
+            }
+
+            for (const auto i : changed) {
+                try {
+                    // Rendered from this document, so what is reported is what was compared
+                    const auto document = cache.get(jobs[i].model, jobs[i].format);
+                    if (document.get_root() == rendered[i]) {
+                        // Written, but the content did not change
+                        continue;
+                    }
+                    rendered[i] = document.get_root();
+                    report(jobs[i], deliver(jobs[i], document), nullptr);
+                } catch (const std::exception &e) {
+                    report(jobs[i], {}, &e);
+                }
+            }
+            changed.clear();
+        }
+    }
+
+
+    datamodel::parse_limits default_server_limits() {
+        datamodel::parse_limits limits;
+        limits.max_nodes = 64 * 1024 * 1024;
+        limits.max_bytes = std::size_t{4} * 1024 * 1024 * 1024;
+        limits.max_string_length = 256 * 1024 * 1024;
+        return limits;
+    }
+
+
+    void serve(const std::filesystem::path &socket_path, const datamodel::parse_limits &limits) {
+        fd_handle listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener.get() < 0) {
+            throw_errno("Failed to create socket");
+        }
+        const auto address = make_address(socket_path);
+        claim_socket_path(socket_path, address);
+        if (::bind(listener.get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+            throw_errno(fmt::format("Failed to bind {}", socket_path.string()));
+        }
+        if (::listen(listener.get(), SOMAXCONN) < 0) {
+            throw_errno("Failed to listen on socket");
+        }
+        // Signalled by the workers whenever they finish a job
+        fd_handle finished(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (finished.get() < 0) {
+            throw_errno("Failed to create eventfd");
+        }
+
+        model_cache cache(limits);
+        std::atomic<size_t> running = 0;
+        const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        // Further clients wait in the listen backlog until a connection finishes
+        const size_t max_connections = 4 * workers;
+
+        auto respond = [](int fd, const nlohmann::json &response) {
+            try {
+                write_line(fd, dump(response));
+            } catch (const std::exception &) {
+                // The client went away, nobody is left to tell
+            }
+        };
+
+        auto render = [&](fd_handle connection, const nlohmann::json &request) {
+            nlohmann::json response;
+            try {
+                response = {{"status", "ok"}, {"output", run_job(cache, from_json(request))}};
+            } catch (const std::exception &e) {
+                response = {{"status", "error"}, {"message", e.what()}};
+            }
+            respond(connection.get(), response);
+            running--;
+            const std::uint64_t one = 1;
+            (void)::write(finished.get(), &one, sizeof(one));
+        };
+
+        // Requests are read here, so workers only ever render and slow
+        // clients cannot hold them
+        std::vector<pending_request> pending;
+        std::vector<pollfd> polled;
+        bool stopping = false;
+        {
+            // Declared last, so the workers are joined before anything they use is destroyed
+            thread_pool pool(workers);
+            while (!stopping) {
+                const bool accepting = pending.size() + running < max_connections;
+                polled.clear();
+                polled.push_back({listener.get(), static_cast<short>(accepting ? POLLIN : 0), 0});
+                polled.push_back({finished.get(), POLLIN, 0});
+                auto wait = std::chrono::milliseconds(-1);
+                const auto now = std::chrono::steady_clock::now();
+                for (const auto &request : pending) {
+                    polled.push_back({request.connection.get(), POLLIN, 0});
+                    const auto left = std::chrono::ceil<std::chrono::milliseconds>(std::max(request.deadline - now, std::chrono::steady_clock::duration::zero()));
+                    wait = wait.count() < 0 ? left : std::min(wait, left);
+                }
+                if (::poll(polled.data(), polled.size(), static_cast<int>(wait.count())) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw_errno("Failed to wait for connections");
+                }
+
+                if (polled[1].revents != 0) {
+                    std::uint64_t count;
+                    (void)::read(finished.get(), &count, sizeof(count));
+                }
+
+                // Walk backwards, so completed requests can be removed in place
+                const auto checked = std::chrono::steady_clock::now();
+                for (size_t i = pending.size(); i-- > 0 && !stopping; ) {
+                    auto &request = pending[i];
+                    nlohmann::json parsed;
+                    std::string command;
+                    try {
+                        if (polled[i + 2].revents != 0 && read_request(request)) {
+                            parsed = nlohmann::json::parse(request.line);
+                            command = parsed.value("command", "render");
+                        } else if (checked >= request.deadline) {
+                            throw std::runtime_error("Timed out waiting for the request");
+                        } else {
+                            continue;
+                        }
+                    } catch (const std::exception &e) {
+                        respond(request.connection.get(), {{"status", "error"}, {"message", e.what()}});
+                        pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(i));
+                        continue;
+                    }
+
+                    auto connection = std::move(request.connection);
+                    pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(i));
+                    if (command == "shutdown") {
+                        stopping = true;
+                        respond(connection.get(), {{"status", "ok"}});
+                    } else if (command == "render") {
+                        running++;
+                        pool.submit([&render, connection = std::move(connection), request = std::move(parsed)]() mutable {
+                            render(std::move(connection), request);
+                        });
+                    } else {
+                        respond(connection.get(), {{"status", "error"}, {"message", fmt::format("Unknown command {}", command)}});
+                    }
+                }
+
+                if (stopping || (polled[0].revents & POLLIN) == 0) {
+                    continue;
+                }
+                const int fd = ::accept4(listener.get(), nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) {
+                        continue;
+                    }
+                    throw_errno("Failed to accept connection");
+                }
+                fd_handle connection(fd);
+                // Guards the blocking reads and the writes of the responses
+                set_timeout(fd, SO_RCVTIMEO, request_timeout);
+                set_timeout(fd, SO_SNDTIMEO, request_timeout);
+                pending.push_back({std::move(connection), {}, std::chrono::steady_clock::now() + request_timeout});
+            }
+
+            // Requests which were not read completely are dropped, queued jobs still finish
+            pending.clear();
+        }
+        std::filesystem::remove(socket_path);
+    }
+
+
+    std::string submit(const std::filesystem::path &socket_path, const render_job &job) {
+        const auto response = send_request(socket_path, to_json(job));
+        return response.value("output", "");
+    }
+
+
+    void request_shutdown(const std::filesystem::path &socket_path) {
+        (void)send_request(socket_path, {{"command", "shutdown"}});
+    }
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include <vole/datamodel_parsers.hpp>
+#include <vole/model_cache.hpp>
+#include <vole/model_composer.hpp>
+#include <vole/output_sink.hpp>
+
+namespace vole::renderer {
+
+    /**
+     * A single unit of work for the renderer
+     */
+    struct render_job {
+        std::filesystem::path model;
+        std::optional<datamodel::model_format> format;
+        // Render into this file instead of returning the text
+        std::optional<std::filesystem::path> output;
+        // If not empty, the model is composed from these files instead of read from `model`
+        std::vector<model_mount> mounts;
+    };
+
+    /**
+     * Get the model of a job from the cache, composing it from the job's
+     * mounts if it has any
+     */
+    [[nodiscard]] datamodel::frozen_document load_model(model_cache &cache, const render_job &job);
+
+    /**
+     * Render a model into a sink, writing the text as it is produced, and
+     * flush the sink once done
+     */
+    void render_model(const datamodel::frozen_document &document, output_sink &sink);
+
+    /**
+     * Render a job, taking its model from the given cache. Output files are
+     * written as the text is produced, only text which is returned is
+     * collected in memory.
+     * @return The rendered text, or nothing if it was written to the job's output file
+     */
+    std::string run_job(model_cache &cache, const render_job &job);
+
+    /**
+     * Receives the result of a job rendered by watch(): the rendered text,
+     * empty if it went to the job's output file, or the error which occurred.
+     */
+    using watch_report = std::function<void(const render_job &job, const std::string &output, const std::exception *error)>;
+
+    /**
+     * Watch the model files of the jobs and render a job again whenever its
+     * model changes. Models are kept in the cache between changes, and a
+     * file which was written without changing its content is not rendered
+     * again. Jobs composed from mounts are not supported.
+     * @param cache The cache holding the models of the last rendering
+     * @param jobs The jobs to keep up to date
+     * @param report Called on the watching thread for every job rendered again
+     * @param stop Watching ends once a stop is requested through it. Without
+     *             one, watch() only returns if watching fails.
+     */
+    void watch(model_cache &cache, const std::vector<render_job> &jobs, const watch_report &report,
+               std::stop_token stop = {});
+
+    /**
+     * The limits a server parses models with unless told otherwise. A server
+     * is shared by its clients, so no single model may take all of its memory.
+     */
+    [[nodiscard]] datamodel::parse_limits default_server_limits();
+
+    /**
+     * Serve render jobs on a local Unix domain socket, keeping parsed models
+     * cached between jobs. Requests are read by the serving thread, which
+     * drops clients that take too long or send too much, and then rendered
+     * on a fixed pool of threads. Only a bounded number of connections are
+     * accepted at a time. Returns once a client requests a shutdown and the
+     * jobs already queued are done.
+     * @param socket_path The socket to listen on. A stale socket file, one
+     *                    nobody listens on anymore, is replaced.
+     * @param limits The resources parsing one model may take
+     * @throws std::runtime_error if something other than a socket exists at
+     *                            the path, or a server is listening on it
+     */
+    void serve(const std::filesystem::path &socket_path,
+               const datamodel::parse_limits &limits = default_server_limits());
+
+    /**
+     * Send a job to a running server and wait for the result.
+     * @return The rendered text, or nothing if it was written to the job's output file
+     */
+    std::string submit(const std::filesystem::path &socket_path, const render_job &job);
+
+    /**
+     * Ask a running server to stop once its in-flight jobs are done
+     */
+    void request_shutdown(const std::filesystem::path &socket_path);
+
+}
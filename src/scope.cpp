@@ -0,0 +1,371 @@
+#include "vole/scope.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <fmt/format.h>
+
+#include "vole/columnar_array.hpp"
+#include "vole/exception.hpp"
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    namespace {
+
+        const datamodel::node *find_member(const datamodel::node &parent, std::string_view name) {
+            const auto object = dynamic_cast<const datamodel::object_node *>(&parent);
+            if (object == nullptr) {
+                return nullptr;
+            }
+            const auto &children = object->get_children();
+            const auto child = std::find_if(children.begin(), children.end(),
+                [name](const auto &candidate) { return candidate->name() == name; });
+            return child == children.end() ? nullptr : child->get();
+        }
+
+
+        const datamodel::node *find_element(const datamodel::node &parent, size_t index) {
+            const auto array = dynamic_cast<const datamodel::array_node *>(&parent);
+            if (array == nullptr || index >= array->get_children().size()) {
+                return nullptr;
+            }
+            return array->get_children()[index].get();
+        }
+
+
+        /**
+         * Read `member` of the element at index straight from the column of a
+         * columnar array, without building the element objects. Only applies
+         * if the member is the last step of the path.
+         * @return The value, or nothing if the regular lookup must be used
+         */
+        std::optional<bound_value> find_cell(const datamodel::node &parent, size_t index, std::string_view path,
+                                             size_t pos, std::mutex &pinned_mutex,
+                                             std::vector<std::shared_ptr<const void>> &pinned) {
+            const auto array = dynamic_cast<const datamodel::columnar_array_node *>(&parent);
+            if (array == nullptr || pos >= path.size() || path[pos] != '.'
+                || path.find_first_of(".[", pos + 1) != std::string_view::npos) {
+                return std::nullopt;
+            }
+            const auto column = array->get_column(path.substr(pos + 1));
+            if (column == nullptr || index >= array->size()) {
+                return std::nullopt;
+            }
+
+            struct cell_reader {
+                size_t index;
+                std::optional<bound_value> operator()(const std::vector<datamodel::num_type> &values) {
+                    return values[index];
+                }
+                std::optional<bound_value> operator()(const std::vector<datamodel::string_type> &values) {
+                    return std::string_view(values[index]);
+                }
+                std::optional<bound_value> operator()(const std::vector<datamodel::literal_value> &values) {
+                    // Nulls and binaries are only represented by nodes
+                    const auto &value = values[index];
+                    if (const auto text = std::get_if<datamodel::string_type>(&value)) {
+                        return std::string_view(*text);
+                    }
+                    if (const auto number = std::get_if<datamodel::num_type>(&value)) {
+                        return *number;
+                    }
+                    if (const auto boolean = std::get_if<datamodel::bool_type>(&value)) {
+                        return *boolean;
+                    }
+                    return std::nullopt;
+                }
+            };
+            auto cell = std::visit(cell_reader{index}, *column);
+            // Text borrows from the column, which a concurrent materialize() would release
+            if (cell.has_value() && std::holds_alternative<std::string_view>(*cell)) {
+                std::lock_guard lock(pinned_mutex);
+                if (std::none_of(pinned.begin(), pinned.end(), [&column](const auto &held) { return held == column; })) {
+                    pinned.push_back(column);
+                }
+            }
+            return cell;
+        }
+
+
+        /**
+         * Turn a literal node into the number or text it holds, so that
+         * accessors stored in the model index like computed ones
+         */
+        bound_value unwrap_literal(const bound_value &value) {
+            const auto node = std::get_if<const datamodel::node *>(&value);
+            const auto literal = node == nullptr ? nullptr : dynamic_cast<const datamodel::literal_node *>(*node);
+            if (literal == nullptr) {
+                return value;
+            }
+            if (const auto number = std::get_if<datamodel::num_type>(&literal->get_value())) {
+                return *number;
+            }
+            if (const auto text = std::get_if<datamodel::string_type>(&literal->get_value())) {
+                return std::string_view(*text);
+            }
+            return value;
+        }
+
+
+        /**
+         * Convert a number used as an array index
+         * @throws no_such_element_exception if it is negative, not integral or too large for an index
+         */
+        size_t to_index(datamodel::num_type number, std::string_view accessor) {
+            // 2^64, exactly representable, unlike the largest size_t. Also rejects NaN.
+            constexpr auto limit = static_cast<datamodel::num_type>(std::numeric_limits<size_t>::max() / 2 + 1) * 2;
+            if (!(number >= 0 && number < limit) || std::trunc(number) != number) {
+                throw no_such_element_exception(
+                    fmt::format("{} is {}, which cannot be used as an index", accessor, datamodel::render_num(number)));
+            }
+            return static_cast<size_t>(number);
+        }
+
+
+        /**
+         * Find the ']' closing the '[' at the given offset, skipping nested accessors
+         */
+        size_t find_closing_bracket(std::string_view path, size_t open) {
+            size_t depth = 0;
+            for (size_t pos = open; pos < path.size(); pos++) {
+                if (path[pos] == '[') {
+                    depth++;
+                } else if (path[pos] == ']' && --depth == 0) {
+                    return pos;
+                }
+            }
+            throw syntax_exception(fmt::format("Unterminated '[' at offset {} of '{}'", open, path));
+        }
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::scope_frame
+     *
+     ************************************************************/
+
+
+    scope_frame::scope_frame(const scope_frame *parent)
+        : parent(parent)
+    {}
+
+
+    scope_frame::scope_frame(const datamodel::node &model)
+        : model(&model)
+    {}
+
+
+    void scope_frame::bind(std::string_view name, bound_value value) {
+        const auto inline_end = inline_bindings.begin() + inline_count;
+        auto existing = std::find_if(inline_bindings.begin(), inline_end,
+            [name](const binding &candidate) { return candidate.name == name; });
+        if (existing != inline_end) {
+            existing->value = value;
+            return;
+        }
+        auto overflow = std::find_if(overflow_bindings.begin(), overflow_bindings.end(),
+            [name](const binding &candidate) { return candidate.name == name; });
+        if (overflow != overflow_bindings.end()) {
+            overflow->value = value;
+            return;
+        }
+
+        if (inline_count < inline_capacity) {
+            inline_bindings[inline_count++] = {name, value};
+        } else {
+            overflow_bindings.push_back({name, value});
+        }
+    }
+
+
+    std::optional<bound_value> scope_frame::find(std::string_view name) const {
+        VOLE_PROFILE_COUNT(lookups, 1);
+        for (auto frame = this; frame != nullptr; frame = frame->parent) {
+            for (size_t i = 0; i < frame->inline_count; i++) {
+                if (frame->inline_bindings[i].name == name) {
+                    return frame->inline_bindings[i].value;
+                }
+            }
+            for (const auto &candidate : frame->overflow_bindings) {
+                if (candidate.name == name) {
+                    return candidate.value;
+                }
+            }
+            if (frame->model != nullptr) {
+                if (const auto member = find_member(*frame->model, name)) {
+                    return member;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+
+    bound_value scope_frame::resolve(std::string_view path) const {
+        const auto name_end = std::min(path.find_first_of(".["), path.size());
+        const auto name = path.substr(0, name_end);
+        if (name.empty()) {
+            throw syntax_exception(fmt::format("Expected a variable name in '{}'", path));
+        }
+        const auto bound = find(name);
+        if (!bound.has_value()) {
+            throw no_such_element_exception(fmt::format("No variable named {} is defined", name));
+        }
+
+        auto value = bound.value();
+        size_t pos = name_end;
+        while (pos < path.size()) {
+            const auto current = std::get_if<const datamodel::node *>(&value);
+            if (current == nullptr || *current == nullptr) {
+                throw no_such_element_exception(
+                    fmt::format("{} is not an array or object", path.substr(0, pos)));
+            }
+
+            const datamodel::node *next = nullptr;
+            if (path[pos] == '.') {
+                const auto member_end = std::min(path.find_first_of(".[", pos + 1), path.size());
+                const auto member = path.substr(pos + 1, member_end - pos - 1);
+                if (member.empty()) {
+                    throw syntax_exception(fmt::format("Expected a member name at offset {} of '{}'", pos, path));
+                }
+                next = find_member(**current, member);
+                pos = member_end;
+            } else if (path[pos] == '[') {
+                const auto close = find_closing_bracket(path, pos);
+                const auto accessor = path.substr(pos + 1, close - pos - 1);
+                std::optional<size_t> index;
+                size_t literal_index = 0;
+                const auto [end, error] = std::from_chars(accessor.data(), accessor.data() + accessor.size(), literal_index);
+                if (error == std::errc() && end == accessor.data() + accessor.size()) {
+                    index = literal_index;
+                } else {
+                    // The accessor is itself an expression, e.g. list[i] or object[key]
+                    const auto key = unwrap_literal(resolve(accessor));
+                    if (const auto number = std::get_if<datamodel::num_type>(&key)) {
+                        index = to_index(*number, accessor);
+                    } else if (const auto counter = std::get_if<int_type>(&key); counter && *counter >= 0) {
+                        index = static_cast<size_t>(*counter);
+                    } else if (const auto text = std::get_if<std::string_view>(&key)) {
+                        next = find_member(**current, *text);
+                    } else {
+                        throw no_such_element_exception(
+                            fmt::format("{} cannot be used as an index", accessor));
+                    }
+                }
+                pos = close + 1;
+                if (index.has_value()) {
+                    if (const auto cell = find_cell(**current, *index, path, pos, pinned_mutex, pinned_columns)) {
+                        return *cell;
+                    }
+                    next = find_element(**current, *index);
+                }
+            } else {
+                throw syntax_exception(fmt::format("Unexpected '{}' at offset {} of '{}'", path[pos], pos, path));
+            }
+
+            if (next == nullptr) {
+                throw no_such_element_exception(
+                    fmt::format("{} does not exist", path.substr(0, pos)));
+            }
+            value = next;
+        }
+        return value;
+    }
+
+
+    /************************************************************
+     *
+     *                  range loops and rendering
+     *
+     ************************************************************/
+
+
+    void write_rendered(const bound_value &value, output_sink &sink) {
+        struct renderer_t {
+            output_sink &sink;
+            void operator()(const datamodel::node *node) {
+                const auto literal = dynamic_cast<const datamodel::literal_node *>(node);
+                if (literal == nullptr) {
+                    throw invalid_operation_exception(
+                        fmt::format("Only literals can be rendered, {} is an {}", node->name(), node->type()));
+                }
+                // Strings are the common case, and need no copy
+                if (const auto text = std::get_if<datamodel::string_type>(&literal->get_value())) {
+                    sink.write(*text);
+                } else {
+                    sink.write(literal->render());
+                }
+            }
+            void operator()(std::string_view text) {sink.write(text);}
+            void operator()(datamodel::num_type number) {sink.write(datamodel::render_num(number));}
+            void operator()(datamodel::bool_type boolean) {sink.write(boolean ? "true" : "false");}
+            void operator()(int_type counter) {
+                std::array<char, std::numeric_limits<int_type>::digits10 + 2> digits;
+                const auto end = std::to_chars(digits.data(), digits.data() + digits.size(), counter).ptr;
+                sink.write(std::string_view(digits.data(), static_cast<size_t>(end - digits.data())));
+            }
+        } renderer {sink};
+        std::visit(renderer, value);
+    }
+
+
+    namespace {
+
+        int_type evaluate_bound(const scope_frame &scope, std::string_view text) {
+            const auto first = text.find_first_not_of(' ');
+            const auto last = text.find_last_not_of(' ');
+            if (first == std::string_view::npos) {
+                throw syntax_exception("Missing range bound");
+            }
+            text = text.substr(first, last - first + 1);
+
+            int_type literal = 0;
+            const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), literal);
+            if (error == std::errc() && end == text.data() + text.size()) {
+                return literal;
+            }
+
+            if (text.starts_with("${") && text.ends_with('}')) {
+                text = text.substr(2, text.size() - 3);
+            }
+            const auto value = scope.resolve(text);
+            if (const auto counter = std::get_if<int_type>(&value)) {
+                return *counter;
+            }
+            auto number = std::get_if<datamodel::num_type>(&value);
+            if (const auto node = std::get_if<const datamodel::node *>(&value)) {
+                // A number stored in the model
+                if (const auto stored = dynamic_cast<const datamodel::literal_node *>(*node)) {
+                    number = std::get_if<datamodel::num_type>(&stored->get_value());
+                }
+            }
+            if (number != nullptr && std::trunc(*number) == *number) {
+                // 2^63, exactly representable, unlike the largest int_type
+                constexpr auto limit = static_cast<datamodel::num_type>(std::numeric_limits<int_type>::min()) * -1;
+                if (*number < -limit || *number >= limit) {
+                    throw invalid_operation_exception(fmt::format("{} is out of the range of a loop counter", text));
+                }
+                return static_cast<int_type>(*number);
+            }
+            throw invalid_operation_exception(fmt::format("{} is not an integer", text));
+        }
+
+    }
+
+
+    integer_range parse_range(const scope_frame &scope, std::string_view expression) {
+        const auto separator = expression.find("..");
+        if (separator == std::string_view::npos) {
+            throw syntax_exception(fmt::format("'{}' is not a range, expected start..end", expression));
+        }
+        return {
+            evaluate_bound(scope, expression.substr(0, separator)),
+            evaluate_bound(scope, expression.substr(separator + 2)),
+        };
+    }
+
+}
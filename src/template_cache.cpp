@@ -0,0 +1,217 @@
+#include "vole/template_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+#include "vole/model_cache.hpp"
+#include "vole/profiler.hpp"
+
+namespace vole {
+
+    std::uint64_t stable_hash(std::string_view data) {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (const auto byte : data) {
+            hash ^= static_cast<unsigned char>(byte);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+
+    namespace {
+
+        std::string cache_key(const std::filesystem::path &path) {
+            return std::filesystem::absolute(path).lexically_normal().string();
+        }
+
+
+        std::string_view trim(std::string_view text) {
+            const auto first = text.find_first_not_of(" \t\r\n");
+            if (first == std::string_view::npos) {
+                return {};
+            }
+            const auto last = text.find_last_not_of(" \t\r\n");
+            return text.substr(first, last - first + 1);
+        }
+
+
+        /**
+         * Find the file a command section pulls in, if it is an `@IMPORT filename@`
+         * or an `@include "filename"@`. Includes of computed expressions cannot
+         * be resolved before rendering and are not dependencies.
+         */
+        std::optional<std::string_view> imported_file(std::string_view command) {
+            command = trim(command);
+            const auto keyword_end = command.find_first_of(" \t\r\n");
+            if (keyword_end == std::string_view::npos) {
+                return std::nullopt;
+            }
+            const auto keyword = command.substr(0, keyword_end);
+            auto argument = trim(command.substr(keyword_end));
+            const bool quoted = argument.size() >= 2 && argument.front() == '"' && argument.back() == '"';
+            if (quoted) {
+                argument = argument.substr(1, argument.size() - 2);
+            }
+
+            if (keyword == "IMPORT" && !argument.empty()) {
+                return argument;
+            }
+            if (keyword == "include" && quoted && !argument.empty()) {
+                return argument;
+            }
+            return std::nullopt;
+        }
+
+    }
+
+
+    /************************************************************
+     *
+     *                  vole::template_cache
+     *
+     ************************************************************/
+
+
+    std::shared_ptr<const compiled_template> template_cache::get(const std::filesystem::path &path) {
+        std::vector<std::filesystem::path> chain;
+        return get(path, chain);
+    }
+
+
+    size_t template_cache::compilations() const {
+        std::lock_guard lock(mutex);
+        return compiled_count;
+    }
+
+
+    template_cache::shared_template template_cache::get(
+            const std::filesystem::path &path,
+            std::vector<std::filesystem::path> &chain) {
+        VOLE_PROFILE_ZONE("load template");
+        const auto key = cache_key(path);
+        if (std::find(chain.begin(), chain.end(), key) != chain.end()) {
+            throw syntax_exception(fmt::format("Template {} imports itself", path.string()));
+        }
+
+        shared_template existing;
+        {
+            std::lock_guard lock(mutex);
+            if (const auto found = entries.find(key); found != entries.end()) {
+                existing = found->second;
+            }
+        }
+        if (existing != nullptr && is_current(*existing)) {
+            return existing;
+        }
+
+        // Stamped before reading, so that a change while reading shows up next time
+        std::error_code error;
+        const auto size = std::filesystem::file_size(key, error);
+        const auto modified = error ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(key, error);
+        auto source = read_file(key);
+        const auto source_hash = stable_hash(source);
+        if (!error) {
+            std::lock_guard lock(mutex);
+            stamps.insert_or_assign(key, file_stamp{size, modified, source_hash});
+        }
+
+        chain.push_back(key);
+        auto compiled = compile(key, std::move(source), source_hash, chain);
+        chain.pop_back();
+        return compiled;
+    }
+
+
+    template_cache::shared_template template_cache::compile(
+            const std::filesystem::path &path,
+            std::string source,
+            std::uint64_t source_hash,
+            std::vector<std::filesystem::path> &chain) {
+        auto compiled = std::make_shared<compiled_template>();
+        compiled->path = path;
+        compiled->source = std::move(source);
+        compiled->source_hash = source_hash;
+        {
+            VOLE_PROFILE_ZONE("tokenize template");
+            compiled->tokens = tokenize_template(compiled->source);
+        }
+        if (profiler::enabled()) {
+            profiler::register_template(path.string(), compiled->source);
+        }
+
+        auto add_dependency = [&compiled](const compiled_template::dependency &dependency) {
+            const auto known = std::find_if(compiled->dependencies.begin(), compiled->dependencies.end(),
+                [&dependency](const auto &candidate) { return candidate.path == dependency.path; });
+            if (known == compiled->dependencies.end()) {
+                compiled->dependencies.push_back(dependency);
+            }
+        };
+
+        for (const auto &token : compiled->tokens) {
+            if (token.kind != token_kind::command) {
+                continue;
+            }
+            const auto file = imported_file(token.text);
+            if (!file.has_value()) {
+                continue;
+            }
+            const auto imported = get(path.parent_path() / *file, chain);
+            add_dependency({imported->path, imported->source_hash});
+            for (const auto &dependency : imported->dependencies) {
+                add_dependency(dependency);
+            }
+        }
+
+        std::lock_guard lock(mutex);
+        compiled_count++;
+        entries.insert_or_assign(path.string(), compiled);
+        return compiled;
+    }
+
+
+    bool template_cache::is_current(const compiled_template &compiled) const {
+        if (file_hash(compiled.path) != compiled.source_hash) {
+            return false;
+        }
+        for (const auto &dependency : compiled.dependencies) {
+            if (file_hash(dependency.path) != dependency.source_hash) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    std::optional<std::uint64_t> template_cache::file_hash(const std::filesystem::path &path) const {
+        const auto key = path.string();
+        std::error_code error;
+        const auto size = std::filesystem::file_size(path, error);
+        const auto modified = error ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(path, error);
+        if (error) {
+            std::lock_guard lock(mutex);
+            stamps.erase(key);
+            return std::nullopt;
+        }
+        {
+            std::lock_guard lock(mutex);
+            const auto known = stamps.find(key);
+            if (known != stamps.end() && known->second.size == size && known->second.modified == modified) {
+                return known->second.hash;
+            }
+        }
+
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (file.is_open() == false) {
+            return std::nullopt;
+        }
+        std::istreambuf_iterator<char> fitr{file}, end;
+        const auto hash = stable_hash(std::string{fitr, end});
+        std::lock_guard lock(mutex);
+        stamps.insert_or_assign(key, file_stamp{size, modified, hash});
+        return hash;
+    }
+
+}
@@ -0,0 +1,172 @@
+#include "vole/template_lexer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fmt/format.h>
+
+#include "vole/exception.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define VOLE_HAVE_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(__GNUC__) || defined(__clang__)
+        #define VOLE_HAVE_AVX2_DISPATCH 1
+        #define VOLE_TARGET(isa) __attribute__((target(isa)))
+    #else
+        #define VOLE_TARGET(isa)
+    #endif
+#endif
+
+namespace vole {
+
+    namespace detail {
+
+        size_t find_marker_scalar(std::string_view text, size_t pos) {
+            for (; pos < text.size(); pos++) {
+                if (text[pos] == '@' || text[pos] == '$') {
+                    return pos;
+                }
+            }
+            return text.size();
+        }
+
+    }
+
+    namespace {
+
+        using marker_finder = size_t (*)(std::string_view, size_t);
+
+#if defined(VOLE_HAVE_X86_SIMD)
+
+        VOLE_TARGET("sse2")
+        size_t find_marker_sse2(std::string_view text, size_t pos) {
+            const auto at = _mm_set1_epi8('@');
+            const auto dollar = _mm_set1_epi8('$');
+            for (; pos + sizeof(__m128i) <= text.size(); pos += sizeof(__m128i)) {
+                const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + pos));
+                const auto matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, at), _mm_cmpeq_epi8(chunk, dollar));
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+                if (mask != 0) {
+                    return pos + std::countr_zero(mask);
+                }
+            }
+            return detail::find_marker_scalar(text, pos);
+        }
+
+#endif
+
+#if defined(VOLE_HAVE_AVX2_DISPATCH)
+
+        VOLE_TARGET("avx2")
+        size_t find_marker_avx2(std::string_view text, size_t pos) {
+            const auto at = _mm256_set1_epi8('@');
+            const auto dollar = _mm256_set1_epi8('$');
+            for (; pos + sizeof(__m256i) <= text.size(); pos += sizeof(__m256i)) {
+                const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + pos));
+                const auto matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, at), _mm256_cmpeq_epi8(chunk, dollar));
+                const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(matches));
+                if (mask != 0) {
+                    return pos + std::countr_zero(mask);
+                }
+            }
+            return find_marker_sse2(text, pos);
+        }
+
+#endif
+
+        marker_finder select_marker_finder() {
+#if defined(VOLE_HAVE_AVX2_DISPATCH)
+            if (__builtin_cpu_supports("avx2")) {
+                return find_marker_avx2;
+            }
+#endif
+#if defined(VOLE_HAVE_X86_SIMD)
+            // SSE2 is part of every x86-64 CPU
+            return find_marker_sse2;
+#else
+            return detail::find_marker_scalar;
+#endif
+        }
+
+
+        [[noreturn]] void throw_unterminated(std::string_view source, size_t offset, std::string_view section) {
+            const auto before = source.substr(0, offset);
+            const auto line = std::count(before.begin(), before.end(), '\n') + 1;
+            const auto line_start = before.rfind('\n');
+            const auto column = offset - (line_start == std::string_view::npos ? 0 : line_start + 1) + 1;
+            throw syntax_exception(
+                fmt::format("Unterminated {} starting at line {}, column {}", section, line, column));
+        }
+
+    }
+
+
+    size_t detail::find_marker(std::string_view text, size_t pos) {
+        static const auto finder = select_marker_finder();
+        return finder(text, pos);
+    }
+
+
+    std::vector<template_token> tokenize_template(std::string_view source) {
+        std::vector<template_token> tokens;
+        // Start of the verbatim run which has not been emitted yet
+        size_t run_start = 0;
+        size_t pos = 0;
+
+        auto flush_run = [&](size_t run_end) {
+            if (run_end > run_start) {
+                tokens.push_back({token_kind::verbatim, source.substr(run_start, run_end - run_start), run_start});
+            }
+        };
+
+        while (true) {
+            const auto marker = detail::find_marker(source, pos);
+            if (marker == source.size()) {
+                flush_run(marker);
+                return tokens;
+            }
+            const char next = marker + 1 < source.size() ? source[marker + 1] : '\0';
+
+            if (source[marker] == '$') {
+                if (next == '{') {
+                    const auto close = source.find('}', marker + 2);
+                    if (close == std::string_view::npos) {
+                        throw_unterminated(source, marker, "render section");
+                    }
+                    flush_run(marker);
+                    tokens.push_back({token_kind::render, source.substr(marker + 2, close - marker - 2), marker});
+                    pos = run_start = close + 1;
+                } else if (next == '$') {
+                    // Keep the first '$' as the end of the current run, drop the second
+                    flush_run(marker + 1);
+                    pos = run_start = marker + 2;
+                } else {
+                    // A lone '$' is plain text
+                    pos = marker + 1;
+                }
+                continue;
+            }
+
+            if (next == '@') {
+                flush_run(marker + 1);
+                pos = run_start = marker + 2;
+            } else if (next == '#') {
+                const auto close = source.find("#@", marker + 2);
+                if (close == std::string_view::npos) {
+                    throw_unterminated(source, marker, "comment section");
+                }
+                flush_run(marker);
+                pos = run_start = close + 2;
+            } else {
+                const auto close = source.find('@', marker + 1);
+                if (close == std::string_view::npos) {
+                    throw_unterminated(source, marker, "command section");
+                }
+                flush_run(marker);
+                tokens.push_back({token_kind::command, source.substr(marker + 1, close - marker - 1), marker});
+                pos = run_start = close + 1;
+            }
+        }
+    }
+
+}
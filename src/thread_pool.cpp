@@ -0,0 +1,54 @@
+#include "vole/thread_pool.hpp"
+
+#include <algorithm>
+
+namespace vole {
+
+    /************************************************************
+     *
+     *                  vole::thread_pool
+     *
+     ************************************************************/
+
+
+    thread_pool::thread_pool(size_t threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+
+    thread_pool::~thread_pool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+
+    void thread_pool::run() {
+        while (true) {
+            std::move_only_function<void()> task;
+            {
+                std::unique_lock lock(mutex);
+                ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    // Only reached once stopping and drained
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+}
@@ -1,6 +1,17 @@
 
 
+#include <vole/columnar_array.hpp>
 #include <vole/datamodel_parsers.hpp>
+#include <vole/exception.hpp>
+#include <vole/model_diff.hpp>
+#include <vole/node_printer.hpp>
+#include <vole/parallel_traversal.hpp>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
 #include "helpers/visualizers.hpp"
 
 #include <gtest/gtest.h>
@@ -29,3 +40,335 @@ TEST(json_parser, Basic_Array) {
     ASSERT_NODE_EQ(*parsed_node, *expected_node);
 }
 
+
+TEST(json_parser, UniformRecordsAreColumnar) {
+    vole::datamodel::json_parser parser;
+    const auto text = R"({"rows": [
+        {"id": 1, "label": "one", "flag": true},
+        {"id": 2, "label": "two", "flag": null},
+        {"id": 3, "label": "three", "flag": false}
+    ]})";
+    auto parsed_node = parser.parse(text);
+    auto rows = std::dynamic_pointer_cast<vole::datamodel::object_node>(parsed_node)->get_child("rows");
+    const auto &columnar = dynamic_cast<const vole::datamodel::columnar_array_node &>(*rows);
+    ASSERT_TRUE(columnar.is_columnar());
+    EXPECT_FALSE(columnar.is_materialized());
+    EXPECT_EQ(columnar.size(), 3);
+    ASSERT_EQ(columnar.get_shape().size(), 3);
+    EXPECT_EQ(columnar.get_shape()[1].view(), "label");
+
+    const auto ids = columnar.get_column("id");
+    ASSERT_NE(ids, nullptr);
+    EXPECT_EQ(std::get<std::vector<vole::datamodel::num_type>>(*ids), (std::vector<double>{1, 2, 3}));
+    const auto labels = columnar.get_column("label");
+    ASSERT_NE(labels, nullptr);
+    EXPECT_EQ(std::get<std::vector<vole::datamodel::string_type>>(*labels)[2], "three");
+    EXPECT_TRUE(std::holds_alternative<std::vector<vole::datamodel::literal_value>>(*columnar.get_column("flag")));
+    EXPECT_EQ(columnar.get_column("missing"), nullptr);
+
+    // The elements read back exactly as if they were stored row-wise
+    auto expected_rows = vole::datamodel::make_array("rows");
+    const std::array<const char *, 3> labels_text = {"one", "two", "three"};
+    const std::array<vole::datamodel::literal_value, 3> flags = {true, nullptr, false};
+    for (size_t i = 0; i < 3; i++) {
+        auto row = vole::datamodel::make_object(fmt::format("rows[{}]", i));
+        row->add_child(vole::datamodel::make_literal("id", static_cast<double>(i + 1)));
+        row->add_child(vole::datamodel::make_literal("label", labels_text[i]));
+        row->add_child(vole::datamodel::make_literal("flag", flags[i]));
+        expected_rows->add_child(row);
+    }
+
+    // Hashing and comparing columnar arrays reads the columns, not elements
+    const auto reparsed = std::dynamic_pointer_cast<vole::datamodel::object_node>(parser.parse(text))->get_child("rows");
+    EXPECT_TRUE(*rows == *reparsed);
+    EXPECT_EQ(rows->subtree_hash(), expected_rows->subtree_hash());
+    EXPECT_FALSE(columnar.is_materialized());
+
+    // So do dumps, diffs and traversals, which build one element at a time
+    EXPECT_EQ(vole::node_printer().render(*rows), vole::node_printer().render(*expected_rows));
+    EXPECT_TRUE(vole::datamodel::diff(*rows, *expected_rows).empty());
+    const auto nodes = vole::datamodel::parallel_reduce<size_t>(*rows,
+        [](const auto &, size_t, size_t &count) { count++; },
+        [](size_t &total, size_t count) { total += count; }, 2);
+    EXPECT_EQ(nodes, 1 + 3 * 4);
+    EXPECT_FALSE(columnar.is_materialized());
+
+    ASSERT_NODE_EQ(*rows, *expected_rows);
+    EXPECT_TRUE(columnar.is_materialized());
+    EXPECT_EQ(rows->subtree_hash(), expected_rows->subtree_hash());
+
+    // The columns are released once the elements exist, unless someone still reads them
+    EXPECT_EQ(columnar.get_column("id"), nullptr);
+    EXPECT_EQ(std::get<std::vector<vole::datamodel::num_type>>(*ids)[2], 3);
+}
+
+TEST(json_parser, MixedRecordsStayRowWise) {
+    vole::datamodel::json_parser parser;
+    const auto text = R"({
+        "reordered": [{"a": 1, "b": 2}, {"b": 3, "a": 4}],
+        "nested": [{"a": {"b": 1}}, {"a": {"b": 2}}],
+        "numbers": [1, 2, 3],
+        "single": [{"a": 1}],
+        "interrupted": [{"a": 1}, {"a": "two"}, 3, {"a": 4}]
+    })";
+    auto parsed_node = std::dynamic_pointer_cast<vole::datamodel::object_node>(parser.parse(text));
+    for (const auto name : {"reordered", "nested", "numbers", "single", "interrupted"}) {
+        const auto array = std::dynamic_pointer_cast<vole::datamodel::columnar_array_node>(parsed_node->get_child(name));
+        ASSERT_NE(array, nullptr) << name;
+        EXPECT_FALSE(array->is_columnar()) << name;
+    }
+
+    // Elements taken into the columns before the array turned out mixed are restored in order
+    auto expected = vole::datamodel::make_array("interrupted");
+    const std::array<vole::datamodel::literal_value, 3> values = {1.0, "two", 4.0};
+    for (size_t i = 0; i < 4; i++) {
+        if (i == 2) {
+            expected->add_child(vole::datamodel::make_literal("interrupted[2]", 3.0));
+            continue;
+        }
+        auto element = vole::datamodel::make_object(fmt::format("interrupted[{}]", i));
+        element->add_child(vole::datamodel::make_literal("a", values[i < 2 ? i : 2]));
+        expected->add_child(element);
+    }
+    ASSERT_NODE_EQ(*parsed_node->get_child("interrupted"), *expected);
+}
+
+
+TEST(json_parser, ProjectedObject) {
+    vole::datamodel::json_parser parser(vole::datamodel::path_projection({"enums[*].name", "version"}));
+    const auto text = R"({
+        "version": {"major": 1, "minor": 2},
+        "comment": {"lines": ["a", "b", "c"]},
+        "enums": [
+            {"name": "Operations", "items": {"ADD": 1, "SUB": 2}},
+            {"name": "Directions", "items": {"NORTH": 1}}
+        ]
+    })";
+    auto parsed_node = parser.parse(text);
+
+    auto version = vole::datamodel::make_object("version");
+    version->add_child(vole::datamodel::make_literal("major", 1.0));
+    version->add_child(vole::datamodel::make_literal("minor", 2.0));
+    auto enums = vole::datamodel::make_array("enums");
+    auto operations = vole::datamodel::make_object("enums[0]");
+    operations->add_child(vole::datamodel::make_literal("name", "Operations"));
+    auto directions = vole::datamodel::make_object("enums[1]");
+    directions->add_child(vole::datamodel::make_literal("name", "Directions"));
+    enums->add_child(operations);
+    enums->add_child(directions);
+    auto expected_node = vole::datamodel::make_object("RootNode");
+    expected_node->add_child(version);
+    expected_node->add_child(enums);
+    ASSERT_NODE_EQ(*parsed_node, *expected_node);
+}
+
+TEST(json_parser, ProjectedArrayIndex) {
+    vole::datamodel::json_parser parser(vole::datamodel::path_projection({"[2]"}));
+    const auto text = R"([[1], {"a": 2}, 3.5, [4]])";
+    auto parsed_node = parser.parse(text);
+    auto expected_node = vole::datamodel::make_array("RootNode");
+    expected_node->add_child(vole::datamodel::make_literal("RootNode[0]", nullptr));
+    expected_node->add_child(vole::datamodel::make_literal("RootNode[1]", nullptr));
+    expected_node->add_child(vole::datamodel::make_literal("RootNode[2]", 3.5));
+    ASSERT_NODE_EQ(*parsed_node, *expected_node);
+}
+
+TEST(path_projection, InvalidPath) {
+    vole::datamodel::path_projection projection;
+    EXPECT_THROW(projection.add_path("enums[x]"), vole::syntax_exception);
+    EXPECT_THROW(projection.add_path("enums..name"), vole::syntax_exception);
+    EXPECT_THROW(projection.add_path("enums[0"), vole::syntax_exception);
+}
+
+TEST(lazy_json_parser, MatchesEagerParser) {
+    const auto text = R"({
+        "name": "Vole \"lazy\"",
+        "values": [1, -2.5, 3e2, true, false, null],
+        "nested": {"empty_array": [], "empty_object": {}, "deep": [[{"x": "y"}]]}
+    })";
+    auto expected_node = vole::datamodel::json_parser().parse(text);
+    auto lazy_node = vole::datamodel::lazy_json_parser().parse(text);
+    ASSERT_NODE_EQ(*lazy_node, *expected_node);
+}
+
+TEST(lazy_json_parser, ConcurrentMaterialization) {
+    std::string text = "[";
+    for (size_t i = 0; i < 200; i++) {
+        text += (i == 0 ? "" : ",") + std::string(R"({"id": 1, "tags": ["a", "b"]})");
+    }
+    text += "]";
+    auto root = std::dynamic_pointer_cast<vole::datamodel::array_node>(
+        vole::datamodel::lazy_json_parser().parse(text));
+    ASSERT_NE(root, nullptr);
+
+    std::vector<std::thread> readers;
+    std::atomic<size_t> total = 0;
+    for (size_t t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            for (const auto &child : root->get_children()) {
+                auto object = std::dynamic_pointer_cast<vole::datamodel::object_node>(child);
+                auto tags = std::dynamic_pointer_cast<vole::datamodel::array_node>(object->get_child("tags"));
+                total += tags->get_children().size();
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(total, 4 * 200 * 2);
+}
+
+TEST(lazy_json_parser, ReportsErrors) {
+    vole::datamodel::lazy_json_parser parser;
+    EXPECT_THROW((void)parser.parse(R"({"a": [1, 2})"), vole::syntax_exception);
+    EXPECT_THROW((void)parser.parse(R"("unterminated)"), vole::syntax_exception);
+
+    auto deferred = parser.parse(R"({"a": [1, nope]})");
+    auto array = std::dynamic_pointer_cast<vole::datamodel::object_node>(deferred)->get_child("a");
+    EXPECT_THROW((void)std::dynamic_pointer_cast<vole::datamodel::array_node>(array)->get_children(),
+        vole::syntax_exception);
+
+    // Both parsers accept the same numbers
+    const auto parses = [](auto &&number_parser, const std::string &number) {
+        try {
+            const auto root = number_parser.parse("[" + number + "]");
+            (void)std::dynamic_pointer_cast<vole::datamodel::array_node>(root)->get_children();
+            return true;
+        } catch (const vole::syntax_exception &) {
+            return false;
+        }
+    };
+    for (const std::string number : {"0", "-0", "10", "1.5", "-0.25e-3", "2E+8", "01", "-01", "1.", ".5", "-", "+1", "1e", "1.e5", "0x1"}) {
+        EXPECT_EQ(parses(parser, number), parses(vole::datamodel::json_parser(), number)) << number;
+    }
+}
+
+TEST(lazy_json_parser, MatchesEagerParserOnEdgeCases) {
+    // The rendered value, or that the input was rejected
+    const auto outcome = [](auto &&any_parser, const std::string &value) -> std::string {
+        try {
+            const auto root = any_parser.parse("[" + value + "]");
+            return std::dynamic_pointer_cast<const vole::datamodel::literal_node>(
+                std::dynamic_pointer_cast<vole::datamodel::array_node>(root)->get_child(0))->render();
+        } catch (const vole::syntax_exception &) {
+            return "<rejected>";
+        }
+    };
+    const std::vector<std::string> inputs = {
+        "-0", "-0.0", "-0e0", "0e-5", "1e400", "-1e400", "1e-400", "-1e-400", "1e-310", "0.0001e400", "100e-402",
+        "18446744073709551616", "-9223372036854775809", "123456789012345678901234567890",
+        R"("plain")", R"("caf\u00e9")", "\"caf\xc3\xa9\"", "\"\xf0\x9f\xa6\xab\"",
+        "\"tab\there\"", "\"line\nbreak\"", std::string("\"nul\0\"", 6), "\"\x7f\"",
+        "\"\xc3\"", "\"\xc0\xaf\"", "\"\xe0\x80\xaf\"", "\"\xed\xa0\x80\"", "\"\xf4\x90\x80\x80\"",
+        "\"\xff\"", "\"\x80\"", "\"\xe2\x82\"", "\"\xf0\x9f\xa6\"",
+        R"("escaped\n\"")", "\"escaped \\n and raw \xc3\"",
+    };
+    for (const auto &input : inputs) {
+        EXPECT_EQ(outcome(vole::datamodel::lazy_json_parser(), input), outcome(vole::datamodel::json_parser(), input))
+            << input;
+    }
+    EXPECT_EQ(outcome(vole::datamodel::lazy_json_parser(), "-0"), "0");
+
+    // Member names are held to the same rules
+    EXPECT_THROW((void)std::dynamic_pointer_cast<vole::datamodel::object_node>(
+        vole::datamodel::lazy_json_parser().parse("{\"\xc3\": 1}"))->get_children(), vole::syntax_exception);
+}
+
+TEST(json_parser, InternsMemberNames) {
+    vole::datamodel::json_parser parser;
+    auto parsed_node = parser.parse(R"([{"id": 1}, {"id": 2}])");
+    auto array = std::dynamic_pointer_cast<vole::datamodel::array_node>(parsed_node);
+    auto first = std::dynamic_pointer_cast<vole::datamodel::object_node>(array->get_child(0));
+    auto second = std::dynamic_pointer_cast<vole::datamodel::object_node>(array->get_child(1));
+    EXPECT_EQ(first->get_child("id")->name().data(), second->get_child("id")->name().data());
+}
+
+TEST(cbor_parser, MatchesJsonParser) {
+    const auto text = R"({"name": "John", "age": 7, "scores": [1.5, -2, null, false]})";
+    const auto encoded = nlohmann::ordered_json::to_cbor(nlohmann::ordered_json::parse(text));
+    auto parsed_node = vole::datamodel::cbor_parser().parse(
+        std::string_view(reinterpret_cast<const char *>(encoded.data()), encoded.size()));
+    auto expected_node = vole::datamodel::json_parser().parse(text);
+    ASSERT_NODE_EQ(*parsed_node, *expected_node);
+}
+
+TEST(msgpack_parser, BinaryLiteral) {
+    nlohmann::json value;
+    value["blob"] = nlohmann::json::binary({0x00, 0x7f, 0xff});
+    const auto encoded = nlohmann::json::to_msgpack(value);
+    auto parsed_node = vole::datamodel::msgpack_parser().parse(
+        std::string_view(reinterpret_cast<const char *>(encoded.data()), encoded.size()));
+
+    auto expected_node = vole::datamodel::make_object("RootNode");
+    expected_node->add_child(vole::datamodel::make_literal(
+        "blob", vole::datamodel::binary_type{0x00, 0x7f, 0xff}));
+    ASSERT_NODE_EQ(*parsed_node, *expected_node);
+
+    auto blob = std::dynamic_pointer_cast<vole::datamodel::object_node>(parsed_node)->get_child("blob");
+    EXPECT_EQ(std::dynamic_pointer_cast<vole::datamodel::literal_node>(blob)->render(), "007fff");
+}
+
+TEST(model_format, FromPath) {
+    EXPECT_EQ(vole::datamodel::format_from_path("model.cbor"), vole::datamodel::model_format::cbor);
+    EXPECT_EQ(vole::datamodel::format_from_path("model.msgpack"), vole::datamodel::model_format::msgpack);
+    EXPECT_EQ(vole::datamodel::format_from_path("model.json"), vole::datamodel::model_format::json);
+    EXPECT_THROW((void)vole::datamodel::format_from_name("yaml"), vole::unsupported_element_exception);
+}
+
+TEST(json_parser, ReportsMalformedInput) {
+    vole::datamodel::json_parser parser;
+    try {
+        (void)parser.parse(R"({"a": tru})");
+        FAIL() << "Expected a syntax_exception";
+    } catch (const vole::syntax_exception &e) {
+        EXPECT_NE(std::string_view(e.what()).find("offset 10"), std::string_view::npos) << e.what();
+    }
+}
+
+TEST(json_parser, EnforcesLimits) {
+    auto limited = [](auto limit) {
+        vole::datamodel::parse_limits limits;
+        limit(limits);
+        auto parser = vole::datamodel::make_parser(vole::datamodel::model_format::json, limits);
+        return parser;
+    };
+    const auto text = R"({"items": [{"name": "first"}, {"name": "second", "tags": [[1]]}]})";
+
+    auto expect_limit = [&text](const std::unique_ptr<vole::datamodel::parser> &parser, std::string_view where) {
+        try {
+            (void)parser->parse(text);
+            FAIL() << "Expected a limit_exceeded_exception at " << where;
+        } catch (const vole::limit_exceeded_exception &e) {
+            EXPECT_TRUE(std::string_view(e.what()).ends_with(where)) << e.what();
+        }
+    };
+    expect_limit(limited([](auto &limits) { limits.max_depth = 4; }), "at RootNode.items[1].tags[0]");
+    expect_limit(limited([](auto &limits) { limits.max_nodes = 5; }), "at RootNode.items[1].name");
+    expect_limit(limited([](auto &limits) { limits.max_string_length = 5; }), "at RootNode.items[1].name");
+    EXPECT_THROW((void)limited([](auto &limits) { limits.max_bytes = 256; })->parse(text),
+                 vole::limit_exceeded_exception);
+    EXPECT_NO_THROW((void)limited([](auto &limits) { limits.max_depth = 5; })->parse(text));
+
+    // Subtrees outside of a projection are not built, but still nested
+    vole::datamodel::json_parser projected(vole::datamodel::path_projection({"items[0]"}));
+    projected.set_limits({.max_depth = 3});
+    EXPECT_THROW((void)projected.parse(text), vole::limit_exceeded_exception);
+
+    // The placeholders which keep projected elements at their index are counted, too
+    vole::datamodel::json_parser late_element(vole::datamodel::path_projection({"[1000]"}));
+    late_element.set_limits({.max_nodes = 100});
+    std::string elements = "[0";
+    for (size_t i = 0; i < 1000; i++) {
+        elements += ",0";
+    }
+    elements += "]";
+    EXPECT_THROW((void)late_element.parse(elements), vole::limit_exceeded_exception);
+    late_element.set_limits({.max_nodes = 1002});
+    EXPECT_NO_THROW((void)late_element.parse(elements));
+
+    vole::datamodel::lazy_json_parser lazy;
+    lazy.set_limits({.max_depth = 4});
+    EXPECT_THROW((void)lazy.parse(text), vole::limit_exceeded_exception);
+    lazy.set_limits({.max_string_length = 5});
+    EXPECT_THROW((void)lazy.parse(text), vole::limit_exceeded_exception);
+}
@@ -1,6 +1,8 @@
 
 #include <vole/datamodel.hpp>
 
+#include <thread>
+
 #include <gtest/gtest.h>
 #include "helpers/assertions.h"
 #include "vole/exception.hpp"
@@ -20,6 +22,12 @@ TEST(literal_node, render_number) {
 
     const vole::datamodel::literal_node fractional_number("RootNode", 200.250);
     EXPECT_STARTS_WITH(fractional_number.render(), "200.250");
+
+    const vole::datamodel::literal_node negative_number("Negative", -65536.0);
+    EXPECT_EQ(negative_number.render(), "-65536");
+
+    const vole::datamodel::literal_node huge_number("Huge", 1e20);
+    EXPECT_EQ(huge_number.render(), "100000000000000000000");
 }
 
 
@@ -45,3 +53,85 @@ TEST(object_node, get_child) {
     EXPECT_EQ(object.get_child("Child1"), child1);
     EXPECT_EQ(object.get_child("Child2"), child2);
 }
+
+
+TEST(frozen_document, rejects_mutation) {
+    auto root = vole::datamodel::make_object("RootNode");
+    auto items = vole::datamodel::make_array("items");
+    root->add_child(items);
+
+    const auto document = vole::datamodel::freeze(root);
+    EXPECT_TRUE(document.root().is_frozen());
+    EXPECT_TRUE(items->is_frozen());
+    EXPECT_THROW(root->add_child(vole::datamodel::make_literal("late", 1.0)),
+        vole::invalid_operation_exception);
+    EXPECT_THROW(items->add_child(vole::datamodel::make_literal("items[0]", 1.0)),
+        vole::invalid_operation_exception);
+}
+
+
+TEST(frozen_document, concurrent_readers) {
+    auto root = vole::datamodel::make_array("RootNode");
+    for (size_t i = 0; i < 1000; i++) {
+        root->add_child(vole::datamodel::make_literal(std::to_string(i), static_cast<double>(i)));
+    }
+    const auto document = vole::datamodel::freeze(root);
+
+    std::vector<std::thread> readers;
+    std::vector<size_t> counts(4, 0);
+    for (size_t t = 0; t < counts.size(); t++) {
+        readers.emplace_back([&document, &count = counts[t]] {
+            const auto &array = dynamic_cast<const vole::datamodel::array_node&>(document.root());
+            for (const auto &child : array.get_children()) {
+                count += child->name().size();
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    for (const auto count : counts) {
+        EXPECT_EQ(count, counts.front());
+    }
+}
+
+
+TEST(name_pool, interns_repeated_names) {
+    vole::datamodel::name_pool pool;
+    const auto first = pool.intern("name");
+    const auto second = pool.intern(std::string("name"));
+    const auto other = pool.intern("items");
+    EXPECT_EQ(first.view().data(), second.view().data());
+    EXPECT_EQ(first, second);
+    EXPECT_FALSE(first == other);
+    EXPECT_EQ(pool.size(), 2);
+
+    // Standalone names and names of other pools still compare by value
+    EXPECT_EQ(first, vole::datamodel::node_name("name"));
+    vole::datamodel::name_pool other_pool;
+    EXPECT_EQ(first, other_pool.intern("name"));
+    EXPECT_FALSE(first == other_pool.intern("items"));
+
+    // Short standalone names are kept inline, long ones are shared
+    const vole::datamodel::node_name element("items[12]");
+    EXPECT_EQ(element.view(), "items[12]");
+    const vole::datamodel::node_name long_name(std::string(40, 'x'));
+    const auto copy = long_name;
+    EXPECT_EQ(copy.view().data(), long_name.view().data());
+}
+
+
+TEST(object_node, get_child_by_handle) {
+    vole::datamodel::name_pool pool;
+    vole::datamodel::object_node object("RootNode");
+    auto child = vole::datamodel::make_literal(pool.intern("Child1"), 1.0);
+    object.add_child(child);
+    EXPECT_EQ(object.get_child(pool.intern("Child1")), child);
+    // Text lookups find members of any pool, or of none
+    object.add_child(vole::datamodel::make_literal("Child2", 2.0));
+    EXPECT_EQ(object.get_child("Child1"), child);
+    EXPECT_EQ(object.get_child("Child2")->name(), "Child2");
+    EXPECT_THROW((void)object.get_child("Child3"), vole::no_such_element_exception);
+    EXPECT_THROW(object.add_child(vole::datamodel::make_literal(pool.intern("Child1"), 2.0)),
+        vole::duplicate_key_exception);
+}
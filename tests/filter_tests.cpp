@@ -0,0 +1,152 @@
+#include <vole/filters.hpp>
+
+#include <algorithm>
+#include <cctype>
+
+#include <gtest/gtest.h>
+#include <vole/datamodel_parsers.hpp>
+#include <vole/exception.hpp>
+#include <vole/node_printer.hpp>
+
+namespace {
+
+    /**
+     * Records the size of every write and the flushes it receives
+     */
+    class recording_sink : public vole::output_sink {
+    public:
+        using output_sink::write;
+
+        void write(std::string_view text) override {
+            this->text += text;
+            largest_write = std::max(largest_write, text.size());
+            writes++;
+        }
+
+        void flush() override {
+            flushes++;
+        }
+
+        std::string text;
+        size_t largest_write = 0;
+        size_t writes = 0;
+        size_t flushes = 0;
+    };
+
+
+    /**
+     * Overrides the line hook printers had before nodes were passed as type and name
+     */
+    class upper_printer : public vole::node_printer {
+    protected:
+        using node_printer::append;
+
+        void append(std::string_view text) override {
+            std::string upper(text);
+            std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+            node_printer::append(upper);
+        }
+    };
+
+
+    /**
+     * Holds back everything written into it until it is drained
+     */
+    class buffering_filter : public vole::filter_stage {
+    public:
+        using filter_stage::filter_stage;
+        using output_sink::write;
+
+        void write(std::string_view text) override {
+            held += text;
+        }
+
+        void drain() override {
+            next.write(held);
+            held.clear();
+        }
+
+    private:
+        std::string held;
+    };
+
+
+    std::string render(const vole::scope_frame &scope, std::string_view expression,
+                       const vole::filter_registry &filters = vole::filter_registry::builtin()) {
+        std::string output;
+        vole::string_sink sink(output);
+        vole::render_expression(scope, expression, sink, filters);
+        return output;
+    }
+
+}
+
+
+TEST(filters, chains_text_filters) {
+    const auto document = vole::datamodel::freeze(
+        vole::datamodel::json_parser().parse(R"({"name": "Colors", "count": 3})"));
+    const vole::scope_frame scope(document.root());
+
+    EXPECT_EQ(render(scope, "name"), "Colors");
+    EXPECT_EQ(render(scope, "name | upper"), "COLORS");
+    EXPECT_EQ(render(scope, "name|upper|lower"), "colors");
+    EXPECT_EQ(render(scope, "count | upper"), "3");
+
+    EXPECT_THROW(render(scope, "name | shout"), vole::no_such_element_exception);
+    EXPECT_THROW(render(scope, "name | upper | dump"), vole::syntax_exception);
+    EXPECT_THROW(render(scope, "name | "), vole::syntax_exception);
+
+    // Stages are drained once the value is written, but the sink is not flushed
+    vole::filter_registry filters;
+    filters.add("buffer", [](vole::output_sink &next) { return std::make_unique<buffering_filter>(next); });
+    EXPECT_EQ(render(scope, "name | buffer | upper", filters), "COLORS");
+    EXPECT_EQ(render(scope, "name | upper | buffer | buffer", filters), "COLORS");
+    recording_sink sink;
+    for (const auto expression : {"name", "name | buffer", "count | dump", "count | dump | buffer"}) {
+        vole::render_expression(scope, expression, sink, filters);
+    }
+    EXPECT_EQ(sink.text, "ColorsColorsnum{count}\nnum{count}\n");
+    EXPECT_EQ(sink.flushes, 0);
+
+    // Sections rendered with their template location write the same
+    vole::render_expression(scope, "name | lower", vole::template_location{"main.vtl", 0}, sink);
+    EXPECT_EQ(sink.text, "ColorsColorsnum{count}\nnum{count}\ncolors");
+}
+
+
+TEST(filters, dumps_any_node) {
+    const auto document = vole::datamodel::freeze(
+        vole::datamodel::json_parser().parse(R"({"items": {"ADD": 1, "SUB": [true]}})"));
+    const vole::scope_frame scope(document.root());
+
+    EXPECT_EQ(render(scope, "items | dump"),
+        "object_node{items}\n"
+        "  num{ADD}\n"
+        "  array_node{SUB}\n"
+        "    bool{SUB[0]}\n");
+    EXPECT_EQ(render(scope, "items.ADD | dump | upper"), "NUM{ADD}\n");
+    EXPECT_THROW(render(scope, "items"), vole::invalid_operation_exception);
+}
+
+
+TEST(node_printer, streams_in_chunks) {
+    auto root = vole::datamodel::make_array("RootNode");
+    for (int i = 0; i < 10000; i++) {
+        root->add_child(vole::datamodel::make_literal("Element", static_cast<double>(i)));
+    }
+
+    recording_sink sink;
+    vole::node_printer printer;
+    printer.render(*root, sink);
+    EXPECT_EQ(sink.text, printer.render(*root));
+    EXPECT_LE(sink.largest_write, vole::chunked_sink::chunk_size);
+    EXPECT_GT(sink.writes, 1);
+    EXPECT_LT(sink.writes, 20);
+}
+
+
+TEST(node_printer, calls_overridden_line_hook) {
+    auto root = vole::datamodel::make_object("RootNode");
+    root->add_child(vole::datamodel::make_literal("name", "x"));
+    EXPECT_EQ(upper_printer().render(*root), "OBJECT_NODE{ROOTNODE}\n  STRING{NAME}\n");
+}
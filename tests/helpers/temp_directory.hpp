@@ -0,0 +1,43 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+namespace vole::helpers {
+
+    /**
+     * A fixture giving each test an empty directory of its own. The
+     * directory is named after the test and removed again afterwards.
+     */
+    class temp_directory_test : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            const auto test = ::testing::UnitTest::GetInstance()->current_test_info();
+            directory = std::filesystem::temp_directory_path()
+                / (std::string("vole_") + test->test_suite_name() + '_' + test->name());
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+        }
+
+        void TearDown() override {
+            std::filesystem::remove_all(directory);
+        }
+
+        /**
+         * Write a file into the directory, replacing it if it exists
+         * @return The path of the file
+         */
+        std::filesystem::path write(std::string_view name, std::string_view text) const {
+            const auto path = directory / name;
+            std::ofstream file(path, std::ios::out | std::ios::trunc);
+            file << text;
+            return path;
+        }
+
+        std::filesystem::path directory;
+    };
+
+}
@@ -0,0 +1,78 @@
+#include <vole/model_cache.hpp>
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+#include "helpers/assertions.h"
+#include "helpers/temp_directory.hpp"
+
+namespace {
+
+    class model_cache_test : public vole::helpers::temp_directory_test {
+    protected:
+        void SetUp() override {
+            temp_directory_test::SetUp();
+            path = directory / "model.json";
+        }
+
+        void write(std::string_view text) const {
+            temp_directory_test::write(path.filename().string(), text);
+        }
+
+        std::filesystem::path path;
+    };
+
+}
+
+
+TEST_F(model_cache_test, reuses_unchanged_models) {
+    write(R"({"a": 1})");
+    vole::model_cache cache;
+    const auto first = cache.get(path);
+    const auto second = cache.get(path);
+    EXPECT_EQ(&first.root(), &second.root());
+    EXPECT_EQ(cache.size(), 1);
+
+    // Touching the file without changing it keeps the model
+    std::filesystem::last_write_time(path,
+        std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+    const auto touched = cache.get(path);
+    EXPECT_EQ(&first.root(), &touched.root());
+}
+
+
+TEST_F(model_cache_test, reparses_changed_models) {
+    write(R"({"a": 1})");
+    vole::model_cache cache;
+    const auto first = cache.get(path);
+
+    write(R"({"a": 1, "b": 2})");
+    const auto second = cache.get(path);
+    EXPECT_NE(&first.root(), &second.root());
+
+    auto expected_node = vole::datamodel::make_object("RootNode");
+    expected_node->add_child(vole::datamodel::make_literal("a", 1.0));
+    expected_node->add_child(vole::datamodel::make_literal("b", 2.0));
+    ASSERT_NODE_EQ(second.root(), *expected_node);
+}
+
+
+TEST_F(model_cache_test, drops_the_least_recently_used_model) {
+    const auto first = directory / "first.json";
+    const auto second = directory / "second.json";
+    temp_directory_test::write("first.json", R"({"a": 1})");
+    temp_directory_test::write("second.json", R"({"b": 2})");
+    write(R"({"c": 3})");
+
+    vole::model_cache cache({}, 2);
+    const auto kept = cache.get(first);
+    const auto dropped = cache.get(second);
+    EXPECT_EQ(&cache.get(first).root(), &kept.root());
+    (void)cache.get(path);
+    EXPECT_EQ(cache.size(), 2);
+
+    // Handed out documents outlive their entry, which is parsed again on the next use
+    EXPECT_EQ(&cache.get(first).root(), &kept.root());
+    EXPECT_NE(&cache.get(second).root(), &dropped.root());
+    ASSERT_NODE_EQ(cache.get(second).root(), dropped.root());
+}
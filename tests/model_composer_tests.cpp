@@ -0,0 +1,128 @@
+#include <vole/model_composer.hpp>
+
+#include <fmt/format.h>
+
+#include <vole/columnar_array.hpp>
+#include <vole/exception.hpp>
+
+#include <gtest/gtest.h>
+#include "helpers/assertions.h"
+#include "helpers/temp_directory.hpp"
+
+namespace {
+
+    class model_composer_test : public vole::helpers::temp_directory_test {
+    protected:
+        vole::model_mount mount(std::string path, std::string_view file,
+                                vole::mount_mode mode = vole::mount_mode::replace) const {
+            return {std::move(path), directory / file, mode, std::nullopt};
+        }
+    };
+
+}
+
+
+TEST(model_mount, parses_command_line_mounts) {
+    const auto replace = vole::parse_mount("config.network=net.json");
+    EXPECT_EQ(replace.path, "config.network");
+    EXPECT_EQ(replace.file, "net.json");
+    EXPECT_EQ(replace.mode, vole::mount_mode::replace);
+
+    const auto merge = vole::parse_mount("+=base.json");
+    EXPECT_EQ(merge.path, "");
+    EXPECT_EQ(merge.mode, vole::mount_mode::merge);
+
+    EXPECT_THROW((void)vole::parse_mount("base.json"), vole::syntax_exception);
+    EXPECT_THROW((void)vole::parse_mount("a..b=base.json"), vole::syntax_exception);
+}
+
+
+TEST_F(model_composer_test, mounts_models_at_paths) {
+    write("base.json", R"({"name": "base", "settings": {"a": 1, "b": 2}})");
+    write("rows.json", R"([{"id": 1}, {"id": 2}])");
+    write("override.json", R"({"b": 3, "c": 4})");
+
+    vole::model_cache cache;
+    const auto composed = vole::compose_models({
+        mount("", "base.json"),
+        mount("data.rows", "rows.json"),
+        mount("settings", "override.json", vole::mount_mode::merge),
+    }, cache);
+
+    auto settings = vole::datamodel::make_object("settings");
+    settings->add_child(vole::datamodel::make_literal("a", 1.0));
+    settings->add_child(vole::datamodel::make_literal("b", 3.0));
+    settings->add_child(vole::datamodel::make_literal("c", 4.0));
+    auto rows = vole::datamodel::make_array("rows");
+    for (int i = 0; i < 2; i++) {
+        auto row = vole::datamodel::make_object(fmt::format("rows[{}]", i));
+        row->add_child(vole::datamodel::make_literal("id", i + 1.0));
+        rows->add_child(row);
+    }
+    auto data = vole::datamodel::make_object("data");
+    data->add_child(rows);
+    auto expected = vole::datamodel::make_object("RootNode");
+    expected->add_child(vole::datamodel::make_literal("name", "base"));
+    expected->add_child(settings);
+    expected->add_child(data);
+    ASSERT_NODE_EQ(composed.root(), *expected);
+
+    // Mounted arrays keep their compact storage
+    const auto &root = dynamic_cast<const vole::datamodel::object_node &>(composed.root());
+    const auto &mounted_data = dynamic_cast<const vole::datamodel::object_node &>(*root.get_child("data"));
+    EXPECT_TRUE(dynamic_cast<const vole::datamodel::columnar_array_node &>(*mounted_data.get_child("rows")).is_columnar());
+
+    // Replacing drops what was mounted before
+    const auto replaced = vole::compose_models({
+        mount("", "base.json"),
+        mount("settings", "override.json"),
+    }, cache);
+    const auto &replaced_root = dynamic_cast<const vole::datamodel::object_node &>(replaced.root());
+    const auto &replaced_settings = dynamic_cast<const vole::datamodel::object_node &>(*replaced_root.get_child("settings"));
+    EXPECT_EQ(replaced_settings.get_children().size(), 2);
+    EXPECT_THROW((void)replaced_settings.get_child("a"), vole::no_such_element_exception);
+}
+
+
+TEST_F(model_composer_test, expands_globs) {
+    write("b.json", R"({"v": 2})");
+    write("a.json", R"({"v": 1})");
+    write("notes.txt", "");
+
+    const auto expanded = vole::expand_mounts({mount("parts", "*.json")});
+    ASSERT_EQ(expanded.size(), 2);
+    EXPECT_EQ(expanded[0].path, "parts.a");
+    EXPECT_EQ(expanded[1].path, "parts.b");
+    EXPECT_EQ(expanded[1].file, directory / "b.json");
+
+    EXPECT_THROW((void)vole::expand_mounts({mount("", "*.cbor")}), vole::no_such_element_exception);
+}
+
+
+TEST_F(model_composer_test, rejects_mounts_below_literals) {
+    write("base.json", R"({"name": "base"})");
+    write("other.json", R"({"v": 1})");
+    vole::model_cache cache;
+    EXPECT_THROW((void)vole::compose_models({mount("", "base.json"), mount("name.inner", "other.json")}, cache),
+                 vole::invalid_operation_exception);
+}
+
+
+TEST_F(model_composer_test, renames_array_elements_under_the_mount) {
+    write("grid.json", R"([[1, 2], [3]])");
+    write("rows.json", R"([{"id": 1}, {"id": 2}])");
+    vole::model_cache cache;
+    // The cached rows are materialized already, so their elements are renamed from the nodes
+    const auto cached = cache.get(directory / "rows.json");
+    const auto &cached_rows = dynamic_cast<const vole::datamodel::array_node &>(cached.root());
+    EXPECT_EQ(cached_rows.get_child(0)->name(), "RootNode[0]");
+
+    const auto composed = vole::compose_models({mount("grid", "grid.json"), mount("rows", "rows.json")}, cache);
+    const auto &root = dynamic_cast<const vole::datamodel::object_node &>(composed.root());
+    const auto &grid = dynamic_cast<const vole::datamodel::array_node &>(*root.get_child("grid"));
+    EXPECT_EQ(grid.get_child(0)->name(), "grid[0]");
+    EXPECT_EQ(dynamic_cast<const vole::datamodel::array_node &>(*grid.get_child(1)).get_child(0)->name(), "grid[1][0]");
+    const auto &rows = dynamic_cast<const vole::datamodel::array_node &>(*root.get_child("rows"));
+    EXPECT_EQ(rows.get_child(1)->name(), "rows[1]");
+    EXPECT_EQ(cached_rows.get_child(1)->name(), "RootNode[1]");
+}
@@ -0,0 +1,70 @@
+#include <vole/model_diff.hpp>
+
+#include <gtest/gtest.h>
+#include <vole/datamodel_parsers.hpp>
+
+using vole::datamodel::change_kind;
+using vole::datamodel::model_change;
+
+namespace {
+
+    vole::datamodel::frozen_document parse(std::string_view json) {
+        return vole::datamodel::freeze(vole::datamodel::json_parser().parse(json));
+    }
+
+}
+
+
+TEST(model_diff, reports_added_removed_and_changed_paths) {
+    const auto before = parse(R"({"name": "colors", "items": [1, 2, 3], "kept": {"a": true}, "gone": null})");
+    const auto after = parse(R"({"items": [1, 5], "name": "colours", "kept": {"a": true}, "new": {"b": 1}})");
+
+    const std::vector<model_change> expected {
+        {change_kind::changed, "name"},
+        {change_kind::changed, "items[1]"},
+        {change_kind::removed, "items[2]"},
+        {change_kind::removed, "gone"},
+        {change_kind::added, "new"},
+    };
+    EXPECT_EQ(vole::datamodel::diff(before.root(), after.root()), expected);
+    EXPECT_TRUE(vole::datamodel::diff(before.root(), before.root()).empty());
+}
+
+
+TEST(model_diff, reports_type_changes_once) {
+    const auto before = parse(R"({"values": {"a": 1, "b": 2}, "flag": 1})");
+    const auto after = parse(R"({"values": [1, 2], "flag": "1"})");
+
+    const std::vector<model_change> expected {
+        {change_kind::changed, "values"},
+        {change_kind::changed, "flag"},
+    };
+    EXPECT_EQ(vole::datamodel::diff(before.root(), after.root()), expected);
+}
+
+
+TEST(model_diff, diffs_mutable_trees) {
+    auto before = vole::datamodel::json_parser().parse(R"({"a": {"b": [true, false]}})");
+    auto after = vole::datamodel::json_parser().parse(R"({"a": {"b": [true, true, false]}})");
+
+    const std::vector<model_change> expected {
+        {change_kind::changed, "a.b[1]"},
+        {change_kind::added, "a.b[2]"},
+    };
+    EXPECT_EQ(vole::datamodel::diff(*before, *after), expected);
+}
+
+
+TEST(node, subtree_hash) {
+    const auto first = parse(R"({"a": [1, "x", null, {"b": false}]})");
+    const auto second = parse(R"({"a": [1, "x", null, {"b": false}]})");
+    const auto third = parse(R"({"a": [1, "x", null, {"b": true}]})");
+
+    EXPECT_EQ(first.root().subtree_hash(), second.root().subtree_hash());
+    EXPECT_NE(first.root().subtree_hash(), third.root().subtree_hash());
+    // Cached hashes stay the same
+    EXPECT_EQ(first.root().subtree_hash(), second.root().subtree_hash());
+    // Values which compare equal hash equally
+    EXPECT_EQ(parse(R"({"a": 0})").root().subtree_hash(), parse(R"({"a": -0.0})").root().subtree_hash());
+    EXPECT_NE(parse(R"({"a": 1})").root().subtree_hash(), parse(R"({"b": 1})").root().subtree_hash());
+}
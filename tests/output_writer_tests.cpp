@@ -0,0 +1,74 @@
+#include <vole/output_writer.hpp>
+
+#include <gtest/gtest.h>
+#include <vole/model_cache.hpp>
+#include "helpers/temp_directory.hpp"
+
+namespace {
+
+    using output_writer_test = vole::helpers::temp_directory_test;
+
+}
+
+
+TEST_F(output_writer_test, writes_files_into_new_directories) {
+    vole::output_writer writer(4);
+    for (int i = 0; i < 200; i++) {
+        writer.write(directory / "enums" / std::to_string(i % 3) / (std::to_string(i) + ".hpp"),
+                     "enum " + std::to_string(i) + ";");
+    }
+    EXPECT_TRUE(writer.wait().empty());
+
+    for (int i = 0; i < 200; i++) {
+        const auto path = directory / "enums" / std::to_string(i % 3) / (std::to_string(i) + ".hpp");
+        EXPECT_EQ(vole::read_file(path), "enum " + std::to_string(i) + ";");
+    }
+    // Only the files themselves, no temporary files left behind
+    size_t files = 0;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(directory)) {
+        files += entry.is_regular_file() ? 1 : 0;
+    }
+    EXPECT_EQ(files, 200);
+}
+
+
+TEST_F(output_writer_test, reports_failures) {
+    // A file where a directory is needed
+    write("blocker", "");
+
+    vole::output_writer writer(2);
+    writer.write(directory / "blocker" / "out.txt", "text");
+    writer.write(directory / "fine.txt", "text");
+    const auto failures = writer.wait();
+    ASSERT_EQ(failures.size(), 1);
+    EXPECT_EQ(failures[0].path, directory / "blocker" / "out.txt");
+    EXPECT_EQ(vole::read_file(directory / "fine.txt"), "text");
+
+    // Failures are only reported once
+    EXPECT_TRUE(writer.wait().empty());
+}
+
+
+TEST_F(output_writer_test, streams_produced_content) {
+    const auto path = write("out.txt", "previous");
+    EXPECT_THROW(vole::write_file_atomically(path, [](vole::output_sink &sink) {
+        sink.write("partial");
+        throw std::runtime_error("failed midway");
+    }), std::runtime_error);
+    // Neither the target nor a temporary file is touched by a failed producer
+    EXPECT_EQ(vole::read_file(path), "previous");
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()), 1);
+
+    vole::output_writer writer(2);
+    writer.write(directory / "streamed" / "out.txt", [](vole::output_sink &sink) {
+        for (int i = 0; i < 3; i++) {
+            sink.write(std::to_string(i));
+        }
+    });
+    writer.write(directory / "failed.txt", [](vole::output_sink &) { throw std::runtime_error("no model"); });
+    const auto failures = writer.wait();
+    ASSERT_EQ(failures.size(), 1);
+    EXPECT_EQ(failures[0].message, "no model");
+    EXPECT_EQ(vole::read_file(directory / "streamed" / "out.txt"), "012");
+    EXPECT_FALSE(std::filesystem::exists(directory / "failed.txt"));
+}
@@ -0,0 +1,143 @@
+#include <vole/parallel_traversal.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+    /**
+     * An array of objects, each holding a number and a nested array
+     */
+    vole::datamodel::shared_node make_tree(size_t objects) {
+        auto root = vole::datamodel::make_array("RootNode");
+        for (size_t i = 0; i < objects; i++) {
+            auto object = vole::datamodel::make_object("Element");
+            object->add_child(vole::datamodel::make_literal("value", static_cast<double>(i)));
+            auto nested = vole::datamodel::make_array("nested");
+            for (size_t j = 0; j < i % 5; j++) {
+                nested->add_child(vole::datamodel::make_literal("Element", true));
+            }
+            object->add_child(nested);
+            root->add_child(object);
+        }
+        return root;
+    }
+
+
+    struct tree_statistics {
+        size_t nodes = 0;
+        size_t max_depth = 0;
+        double sum = 0;
+    };
+
+
+    class literal_counter : public vole::datamodel::parallel_descender {
+    public:
+        // One count per worker, a single one when descending sequentially
+        std::vector<size_t> counts = {0};
+
+    protected:
+        void on_start(size_t workers) override {
+            counts.assign(workers, 0);
+        }
+
+        void on_enter(const vole::datamodel::literal_node &) override {
+            counts[get_worker()]++;
+        }
+    };
+
+}
+
+
+TEST(parallel_traversal, visits_every_node_once) {
+    const auto document = vole::datamodel::freeze(make_tree(5000));
+    for (const size_t threads : {1, 2, 8}) {
+        const auto statistics = vole::datamodel::parallel_reduce<tree_statistics>(document.root(),
+            [](const vole::datamodel::node &node, size_t depth, tree_statistics &state) {
+                state.nodes++;
+                state.max_depth = std::max(state.max_depth, depth);
+                if (const auto literal = dynamic_cast<const vole::datamodel::literal_node *>(&node)) {
+                    if (const auto number = std::get_if<double>(&literal->get_value())) {
+                        state.sum += *number;
+                    }
+                }
+            },
+            [](tree_statistics &total, const tree_statistics &part) {
+                total.nodes += part.nodes;
+                total.max_depth = std::max(total.max_depth, part.max_depth);
+                total.sum += part.sum;
+            },
+            threads);
+
+        // Root, 5000 objects with two members each, and 2 nested elements on average
+        EXPECT_EQ(statistics.nodes, 1 + 5000 * 3 + 10000);
+        EXPECT_EQ(statistics.max_depth, 3);
+        EXPECT_EQ(statistics.sum, 4999.0 * 5000 / 2);
+    }
+}
+
+
+TEST(parallel_traversal, reduces_in_tree_order) {
+    const auto document = vole::datamodel::freeze(make_tree(3000));
+    std::vector<const vole::datamodel::node *> expected;
+    const auto walk = [&expected](const auto &self, const vole::datamodel::node &node) -> void {
+        expected.push_back(&node);
+        if (const auto parent = dynamic_cast<const vole::datamodel::array_node *>(&node)) {
+            for (const auto &child : parent->get_children()) {
+                self(self, *child);
+            }
+        } else if (const auto object = dynamic_cast<const vole::datamodel::object_node *>(&node)) {
+            for (const auto &child : object->get_children()) {
+                self(self, *child);
+            }
+        }
+    };
+    walk(walk, document.root());
+
+    // Appending is associative but not commutative, so any other order would show
+    for (const size_t threads : {1, 3, 8, 8}) {
+        const auto visited = vole::datamodel::parallel_reduce<std::vector<const vole::datamodel::node *>>(
+            document.root(),
+            [](const vole::datamodel::node &node, size_t, std::vector<const vole::datamodel::node *> &state) {
+                state.push_back(&node);
+            },
+            [](std::vector<const vole::datamodel::node *> &total, const std::vector<const vole::datamodel::node *> &part) {
+                total.insert(total.end(), part.begin(), part.end());
+            },
+            threads);
+        EXPECT_EQ(visited, expected);
+    }
+}
+
+
+TEST(parallel_traversal, descenders_opt_in) {
+    const auto document = vole::datamodel::freeze(make_tree(1000));
+
+    literal_counter sequential;
+    document.root().apply(sequential);
+    EXPECT_EQ(sequential.counts[0], 1000 + 2000);
+
+    literal_counter parallel;
+    parallel.descend_parallel(document.root(), 4);
+    ASSERT_EQ(parallel.counts.size(), 4);
+    size_t total = 0;
+    for (const auto count : parallel.counts) {
+        total += count;
+    }
+    EXPECT_EQ(total, 1000 + 2000);
+}
+
+
+TEST(parallel_traversal, rethrows_visitor_exceptions) {
+    const auto document = vole::datamodel::freeze(make_tree(1000));
+    EXPECT_THROW(vole::datamodel::parallel_reduce<size_t>(document.root(),
+        [](const vole::datamodel::node &, size_t depth, size_t &) {
+            if (depth == 3) {
+                throw std::runtime_error("too deep");
+            }
+        },
+        [](size_t &, size_t) {},
+        4), std::runtime_error);
+}
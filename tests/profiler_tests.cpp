@@ -0,0 +1,96 @@
+#include <vole/profiler.hpp>
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+    class profiler_test : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            vole::profiler::reset();
+            vole::profiler::enable();
+        }
+
+        void TearDown() override {
+            vole::profiler::disable();
+            vole::profiler::reset();
+        }
+    };
+
+}
+
+
+TEST_F(profiler_test, records_nested_zones) {
+    {
+        vole::profile_zone outer("render");
+        for (int i = 0; i < 3; i++) {
+            vole::profile_zone inner("loop");
+            vole::profile_count(vole::profile_counter::iterations, 1);
+            vole::profile_count(vole::profile_counter::lookups, 2);
+        }
+        vole::profile_count(vole::profile_counter::output_bytes, 100);
+    }
+
+    std::stringstream trace;
+    vole::profiler::write_trace(trace);
+    const auto parsed = nlohmann::json::parse(trace.str());
+    const auto &events = parsed.at("traceEvents");
+    ASSERT_EQ(events.size(), 4);
+    EXPECT_EQ(events[0]["name"], "loop");
+    EXPECT_EQ(events[0]["ph"], "X");
+    EXPECT_EQ(events[0]["args"]["iterations"], 1);
+    EXPECT_EQ(events[0]["args"]["lookups"], 2);
+    EXPECT_EQ(events[3]["name"], "render");
+    EXPECT_EQ(events[3]["args"]["output_bytes"], 100);
+    EXPECT_GE(events[3]["dur"].get<double>(), events[0]["dur"].get<double>());
+
+    std::stringstream folded;
+    vole::profiler::write_folded(folded);
+    EXPECT_NE(folded.str().find("render;loop "), std::string::npos);
+
+    std::stringstream summary;
+    vole::profiler::write_summary(summary);
+    EXPECT_NE(summary.str().find("profiler_tests.cpp"), std::string::npos);
+}
+
+
+TEST_F(profiler_test, attributes_zones_to_template_locations) {
+    vole::profiler::register_template("main.vtl", "Hello\n  ${name}\n");
+    {
+        vole::profile_zone outer("render");
+        vole::profile_zone section("render section", vole::template_location{"main.vtl", 8});
+        vole::profile_zone unknown("render section", vole::template_location{"other.vtl", 8});
+    }
+
+    std::stringstream trace;
+    vole::profiler::write_trace(trace);
+    const auto events = nlohmann::json::parse(trace.str()).at("traceEvents");
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_EQ(events[0]["args"]["location"], "other.vtl@8");
+    EXPECT_EQ(events[1]["args"]["location"], "main.vtl:2:3");
+
+    std::stringstream folded;
+    vole::profiler::write_folded(folded);
+    EXPECT_NE(folded.str().find("render;render section (main.vtl:2:3);render section (other.vtl@8) "),
+        std::string::npos);
+
+    std::stringstream summary;
+    vole::profiler::write_summary(summary);
+    EXPECT_NE(summary.str().find("render section (main.vtl:2:3)"), std::string::npos);
+}
+
+
+TEST_F(profiler_test, records_nothing_while_disabled) {
+    vole::profiler::disable();
+    {
+        vole::profile_zone zone("ignored");
+        vole::profile_count(vole::profile_counter::iterations, 1);
+    }
+
+    std::stringstream trace;
+    vole::profiler::write_trace(trace);
+    EXPECT_TRUE(nlohmann::json::parse(trace.str()).at("traceEvents").empty());
+}
@@ -0,0 +1,206 @@
+#include "render_service.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "helpers/temp_directory.hpp"
+
+namespace {
+
+    /**
+     * Connect to a Unix domain socket
+     * @return The connected descriptor, or -1 if nobody listens on it
+     */
+    int connect_to(const std::filesystem::path &socket_path) {
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        socket_path.string().copy(address.sun_path, sizeof(address.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+
+    class render_service_test : public vole::helpers::temp_directory_test {
+    protected:
+        void SetUp() override {
+            temp_directory_test::SetUp();
+            socket_path = directory / "server.sock";
+        }
+
+        void TearDown() override {
+            if (server.joinable()) {
+                vole::renderer::request_shutdown(socket_path);
+                server.join();
+            }
+            temp_directory_test::TearDown();
+        }
+
+        /**
+         * Run a server on the socket and wait until it accepts connections
+         */
+        void start_server(const vole::datamodel::parse_limits &limits = vole::renderer::default_server_limits()) {
+            server = std::thread([this, limits] {
+                try {
+                    vole::renderer::serve(socket_path, limits);
+                } catch (...) {
+                    failure = std::current_exception();
+                }
+            });
+            for (int attempt = 0; attempt < 500; attempt++) {
+                if (const int fd = connect_to(socket_path); fd >= 0) {
+                    ::close(fd);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            FAIL() << "The server did not start listening";
+        }
+
+        void stop_server() {
+            vole::renderer::request_shutdown(socket_path);
+            server.join();
+            if (failure != nullptr) {
+                std::rethrow_exception(failure);
+            }
+        }
+
+        std::filesystem::path socket_path;
+        std::thread server;
+        std::exception_ptr failure;
+    };
+
+}
+
+
+TEST_F(render_service_test, serves_jobs_until_shutdown) {
+    // A socket nobody listens on anymore, as a crashed server leaves it
+    {
+        const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        socket_path.string().copy(address.sun_path, sizeof(address.sun_path) - 1);
+        ASSERT_EQ(::bind(stale, reinterpret_cast<const sockaddr *>(&address), sizeof(address)), 0);
+        ::close(stale);
+    }
+    start_server();
+
+    const vole::renderer::render_job job{write("model.json", R"({"a": [1, "x"]})"), std::nullopt, std::nullopt, {}};
+    vole::model_cache cache;
+    EXPECT_EQ(vole::renderer::submit(socket_path, job), vole::renderer::run_job(cache, job));
+
+    auto missing = job;
+    missing.model = directory / "missing.json";
+    EXPECT_THROW((void)vole::renderer::submit(socket_path, missing), std::runtime_error);
+
+    stop_server();
+    EXPECT_FALSE(std::filesystem::exists(socket_path));
+}
+
+
+TEST_F(render_service_test, refuses_a_socket_in_use) {
+    start_server();
+    EXPECT_THROW(vole::renderer::serve(socket_path), std::runtime_error);
+    // The running server still answers
+    const vole::renderer::render_job job{write("model.json", R"({"a": 1})"), std::nullopt, std::nullopt, {}};
+    EXPECT_NO_THROW((void)vole::renderer::submit(socket_path, job));
+    stop_server();
+}
+
+
+TEST_F(render_service_test, idle_clients_do_not_hold_the_server) {
+    start_server();
+    // Connected, but never sending a request
+    std::vector<int> idle;
+    for (unsigned i = 0; i < 2 * std::max(1u, std::thread::hardware_concurrency()); i++) {
+        idle.push_back(connect_to(socket_path));
+        ASSERT_GE(idle.back(), 0);
+    }
+    const vole::renderer::render_job job{write("model.json", R"({"a": 1})"), std::nullopt, std::nullopt, {}};
+    EXPECT_NO_THROW((void)vole::renderer::submit(socket_path, job));
+    stop_server();
+    for (const int fd : idle) {
+        ::close(fd);
+    }
+}
+
+
+TEST_F(render_service_test, parses_with_its_limits) {
+    vole::datamodel::parse_limits limits;
+    limits.max_nodes = 2;
+    start_server(limits);
+    const vole::renderer::render_job small{write("small.json", R"({"a": 1})"), std::nullopt, std::nullopt, {}};
+    const vole::renderer::render_job large{write("large.json", R"({"a": [1, 2]})"), std::nullopt, std::nullopt, {}};
+    EXPECT_NO_THROW((void)vole::renderer::submit(socket_path, small));
+    EXPECT_THROW((void)vole::renderer::submit(socket_path, large), std::runtime_error);
+    stop_server();
+
+    // Shared servers bound every resource by default
+    const auto defaults = vole::renderer::default_server_limits();
+    EXPECT_NE(defaults.max_nodes, vole::datamodel::parse_limits::unlimited);
+    EXPECT_NE(defaults.max_bytes, vole::datamodel::parse_limits::unlimited);
+    EXPECT_NE(defaults.max_string_length, vole::datamodel::parse_limits::unlimited);
+}
+
+
+TEST_F(render_service_test, watch_renders_changed_models_once) {
+    const auto model = write("model.json", R"({"a": 0})");
+    const std::vector<vole::renderer::render_job> jobs{{model, std::nullopt, std::nullopt, {}}};
+    vole::model_cache cache;
+    (void)cache.get(model);
+
+    std::mutex mutex;
+    std::condition_variable reported;
+    std::vector<std::string> outputs;
+    std::jthread watcher([&](std::stop_token stop) {
+        vole::renderer::watch(cache, jobs, [&](const auto &, const std::string &output, const std::exception *error) {
+            std::lock_guard lock(mutex);
+            outputs.push_back(error == nullptr ? output : std::string("error: ") + error->what());
+            reported.notify_all();
+        }, stop);
+    });
+    const auto wait_for = [&](size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock lock(mutex);
+        return reported.wait_for(lock, timeout, [&] { return outputs.size() >= count; });
+    };
+
+    // The watch starts at some point, keep changing the model until it notices
+    std::string content;
+    for (int i = 1; i < 100 && !wait_for(1, std::chrono::milliseconds(100)); i++) {
+        content = "{\"a\": " + std::to_string(i) + "}";
+        write("model.json", content);
+    }
+    ASSERT_TRUE(wait_for(1, std::chrono::milliseconds(0)));
+    // Let events of earlier writes settle
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    size_t seen = 0;
+    {
+        std::lock_guard lock(mutex);
+        seen = outputs.size();
+        vole::model_cache fresh;
+        const vole::renderer::render_job expected{write("expected.json", content), std::nullopt, std::nullopt, {}};
+        EXPECT_EQ(outputs.back(), vole::renderer::run_job(fresh, expected));
+    }
+
+    // Written again with the same content, nothing to render
+    write("model.json", content);
+    EXPECT_FALSE(wait_for(seen + 1, std::chrono::milliseconds(300)));
+
+    write("model.json", R"({"b": [true, false]})");
+    EXPECT_TRUE(wait_for(seen + 1, std::chrono::seconds(5)));
+
+    watcher.request_stop();
+    watcher.join();
+}
@@ -0,0 +1,171 @@
+#include <vole/scope.hpp>
+
+#include <vole/columnar_array.hpp>
+#include <vole/datamodel_parsers.hpp>
+#include <vole/exception.hpp>
+
+#include <limits>
+#include <thread>
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+    vole::datamodel::shared_node example_model() {
+        return vole::datamodel::json_parser().parse(R"({
+            "enums": [
+                {"name": "Operations", "items": {"ADD": 1, "SUB": 2}},
+                {"name": "Directions", "items": {"NORTH": 1}}
+            ]
+        })");
+    }
+
+    std::string render(const vole::bound_value &value) {
+        const auto node = std::get<const vole::datamodel::node *>(value);
+        return dynamic_cast<const vole::datamodel::literal_node &>(*node).render();
+    }
+
+}
+
+
+TEST(scope_frame, resolves_model_paths) {
+    const auto model = example_model();
+    const vole::scope_frame root(*model);
+    EXPECT_EQ(render(root.resolve("enums[1].name")), "Directions");
+    EXPECT_EQ(render(root.resolve("enums[0].items.SUB")), "2");
+    EXPECT_THROW((void)root.resolve("enums[2]"), vole::no_such_element_exception);
+    EXPECT_THROW((void)root.resolve("missing"), vole::no_such_element_exception);
+    EXPECT_THROW((void)root.resolve("enums[0"), vole::syntax_exception);
+}
+
+
+TEST(scope_frame, reads_columnar_members_in_place) {
+    const auto model = vole::datamodel::json_parser().parse(R"({
+        "rows": [{"id": 1, "name": "a", "extra": null}, {"id": 2, "name": "b", "extra": true}]
+    })");
+    const vole::scope_frame root(*model);
+    EXPECT_EQ(std::get<vole::datamodel::num_type>(root.resolve("rows[1].id")), 2);
+    const auto name = std::get<std::string_view>(root.resolve("rows[0].name"));
+    EXPECT_EQ(name, "a");
+    EXPECT_EQ(std::get<vole::datamodel::bool_type>(root.resolve("rows[1].extra")), true);
+
+    const auto &rows = dynamic_cast<const vole::datamodel::columnar_array_node &>(
+        *std::get<const vole::datamodel::node *>(root.resolve("rows")));
+    EXPECT_FALSE(rows.is_materialized());
+
+    // Values without a plain representation fall back to the element nodes
+    EXPECT_EQ(render(root.resolve("rows[0].extra")), "null");
+    EXPECT_TRUE(rows.is_materialized());
+    EXPECT_THROW((void)root.resolve("rows[2].id"), vole::no_such_element_exception);
+
+    // The released columns stay alive for the text the frame handed out
+    EXPECT_EQ(rows.get_column("name"), nullptr);
+    EXPECT_EQ(name, "a");
+    EXPECT_EQ(render(root.resolve("rows[1].name")), "b");
+}
+
+TEST(scope_frame, resolves_columns_from_several_threads) {
+    const auto document = vole::datamodel::freeze(vole::datamodel::json_parser().parse(R"({
+        "rows": [{"name": "a", "kind": "x"}, {"name": "b", "kind": "y"}]
+    })"));
+    const vole::scope_frame root(document.root());
+
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 4; reader++) {
+        readers.emplace_back([&root, reader] {
+            for (int i = 0; i < 1000; i++) {
+                const auto path = fmt::format("rows[{}].{}", (i + reader) % 2, i % 3 == 0 ? "kind" : "name");
+                EXPECT_FALSE(std::get<std::string_view>(root.resolve(path)).empty());
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+}
+
+TEST(scope_frame, loop_bindings_shadow_and_rebind) {
+    const auto model = example_model();
+    const vole::scope_frame root(*model);
+    const auto &enums = dynamic_cast<const vole::datamodel::array_node &>(
+        *std::get<const vole::datamodel::node *>(root.resolve("enums")));
+
+    std::vector<std::string> seen;
+    {
+        vole::scope_frame loop(&root);
+        for (const auto &item : enums.get_children()) {
+            loop.bind("enum", item.get());
+            vole::scope_frame inner(&loop);
+            const auto &items = dynamic_cast<const vole::datamodel::object_node &>(
+                *std::get<const vole::datamodel::node *>(inner.resolve("enum.items")));
+            for (const auto &entry : items.get_children()) {
+                inner.bind("key", entry->name());
+                inner.bind("value", entry.get());
+                seen.push_back(fmt::format("{}.{}={}",
+                    render(inner.resolve("enum.name")),
+                    std::get<std::string_view>(inner.find("key").value()),
+                    render(inner.resolve("value"))));
+            }
+        }
+        // Bindings live in the loop's own frame, not in its parent
+        EXPECT_TRUE(loop.find("enum").has_value());
+        EXPECT_FALSE(root.find("enum").has_value());
+    }
+    EXPECT_EQ(seen, (std::vector<std::string>{"Operations.ADD=1", "Operations.SUB=2", "Directions.NORTH=1"}));
+
+    // Loop variables are gone once their frame is popped
+    EXPECT_THROW((void)root.resolve("enum.name"), vole::no_such_element_exception);
+
+    // A frame reused by the next iteration sees only the value bound last
+    vole::scope_frame next(&root);
+    for (const auto index : {1, 0}) {
+        next.bind("enum", enums.get_children()[index].get());
+        vole::scope_frame body(&next);
+        EXPECT_EQ(render(body.resolve("enum.name")), index == 1 ? "Directions" : "Operations");
+    }
+}
+
+
+TEST(scope_frame, dynamic_accessors) {
+    const auto model = example_model();
+    const vole::scope_frame root(*model);
+    vole::scope_frame frame(&root);
+    frame.bind("i", 1.0);
+    frame.bind("field", std::string_view("name"));
+    EXPECT_EQ(render(frame.resolve("enums[i][field]")), "Directions");
+
+    // Accessors stored in the model index like bound ones
+    const auto config = vole::datamodel::json_parser().parse(R"({"idx": 1, "key": "name", "half": 1.5, "huge": 1e300})");
+    frame.bind("config", config.get());
+    EXPECT_EQ(render(frame.resolve("enums[config.idx][config.key]")), "Directions");
+
+    // Only integral numbers within range are indices
+    EXPECT_THROW((void)frame.resolve("enums[config.half]"), vole::no_such_element_exception);
+    EXPECT_THROW((void)frame.resolve("enums[config.huge]"), vole::no_such_element_exception);
+    frame.bind("i", -1.0);
+    EXPECT_THROW((void)frame.resolve("enums[i]"), vole::no_such_element_exception);
+    frame.bind("i", std::numeric_limits<double>::infinity());
+    EXPECT_THROW((void)frame.resolve("enums[i]"), vole::no_such_element_exception);
+}
+
+
+TEST(for_range, binds_unboxed_counters) {
+    const auto model = vole::datamodel::json_parser().parse(R"({"count": 4, "huge": 1e300, "half": 0.5})");
+    const vole::scope_frame root(*model);
+    vole::scope_frame loop(&root);
+
+    std::string output;
+    vole::string_sink sink(output);
+    vole::for_range(loop, "i", vole::parse_range(root, "-1..${count}"), [&] {
+        const auto value = loop.find("i").value();
+        EXPECT_TRUE(std::holds_alternative<vole::int_type>(value));
+        vole::write_rendered(value, sink);
+        sink.write(' ');
+    });
+    EXPECT_EQ(output, "-1 0 1 2 3 ");
+
+    EXPECT_THROW((void)vole::parse_range(root, "0-3"), vole::syntax_exception);
+    EXPECT_THROW((void)vole::parse_range(root, "0..${huge}"), vole::invalid_operation_exception);
+    EXPECT_THROW((void)vole::parse_range(root, "0..${half}"), vole::invalid_operation_exception);
+}
@@ -0,0 +1,89 @@
+#include <vole/template_cache.hpp>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <vole/exception.hpp>
+#include "helpers/temp_directory.hpp"
+
+namespace {
+
+    using template_cache_test = vole::helpers::temp_directory_test;
+
+}
+
+
+TEST_F(template_cache_test, recompiles_only_changed_imports) {
+    const auto main = write("main.vtl", "@IMPORT header.vtl@body ${name}");
+    const auto header = write("header.vtl", "@include \"footer.vtl\"@header");
+    write("footer.vtl", "footer");
+
+    vole::template_cache cache;
+    const auto first = cache.get(main);
+    EXPECT_EQ(cache.compilations(), 3);
+    ASSERT_EQ(first->dependencies.size(), 2);
+    EXPECT_EQ(first->tokens.back().text, "name");
+
+    EXPECT_EQ(cache.get(main), first);
+    EXPECT_EQ(cache.compilations(), 3);
+
+    // Rewriting a file with the same content only makes the cache hash it again
+    write("footer.vtl", "footer");
+    EXPECT_EQ(cache.get(main), first);
+    EXPECT_EQ(cache.compilations(), 3);
+
+    // A change two imports away invalidates the chain, but not unrelated templates
+    write("footer.vtl", "new footer");
+    const auto second = cache.get(main);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(cache.compilations(), 6);
+    EXPECT_EQ(cache.get(header), cache.get(header));
+    EXPECT_EQ(cache.compilations(), 6);
+}
+
+
+TEST_F(template_cache_test, checks_the_template_itself_like_its_imports) {
+    const auto main = write("main.vtl", "@IMPORT part.vtl@before ${value}");
+    write("part.vtl", "part");
+
+    vole::template_cache cache;
+    const auto first = cache.get(main);
+    EXPECT_EQ(cache.compilations(), 2);
+
+    // Only the changed template is compiled again, its unchanged import is reused
+    write("main.vtl", "@IMPORT part.vtl@before ${other} after");
+    const auto second = cache.get(main);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(second->tokens.back().text, " after");
+    EXPECT_EQ(cache.compilations(), 3);
+    EXPECT_EQ(second->source_hash, vole::stable_hash("@IMPORT part.vtl@before ${other} after"));
+}
+
+
+TEST_F(template_cache_test, serves_several_threads) {
+    const auto main = write("main.vtl", "@IMPORT part.vtl@body");
+    write("part.vtl", "part");
+
+    vole::template_cache cache;
+    const auto expected = cache.get(main);
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 4; reader++) {
+        readers.emplace_back([&cache, &main, &expected] {
+            for (int i = 0; i < 100; i++) {
+                EXPECT_EQ(cache.get(main), expected);
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(cache.compilations(), 2);
+}
+
+
+TEST_F(template_cache_test, rejects_import_cycles) {
+    const auto first = write("first.vtl", "@IMPORT second.vtl@");
+    write("second.vtl", "@IMPORT first.vtl@");
+    vole::template_cache cache;
+    EXPECT_THROW(static_cast<void>(cache.get(first)), vole::syntax_exception);
+}
@@ -0,0 +1,61 @@
+#include <vole/template_lexer.hpp>
+
+#include <random>
+
+#include <vole/exception.hpp>
+
+#include <gtest/gtest.h>
+
+using vole::template_token;
+using vole::token_kind;
+
+
+TEST(template_lexer, tokenizes_blocks) {
+    const std::string_view source = "@# header #@Hello ${user.name}, you owe $$5 or $3 @@home\n@for i in 0..3@x@end for@";
+    const auto tokens = vole::tokenize_template(source);
+    const std::vector<template_token> expected {
+        {token_kind::verbatim, "Hello ", 12},
+        {token_kind::render, "user.name", 18},
+        {token_kind::verbatim, ", you owe $", 30},
+        {token_kind::verbatim, "5 or $3 @", 42},
+        {token_kind::verbatim, "home\n", 52},
+        {token_kind::command, "for i in 0..3", 57},
+        {token_kind::verbatim, "x", 72},
+        {token_kind::command, "end for", 73},
+    };
+    EXPECT_EQ(tokens, expected);
+}
+
+
+TEST(template_lexer, verbatim_spans_point_into_source) {
+    const std::string source(100000, 'v');
+    const auto tokens = vole::tokenize_template(source);
+    ASSERT_EQ(tokens.size(), 1);
+    EXPECT_EQ(tokens[0].text.data(), source.data());
+    EXPECT_EQ(tokens[0].text.size(), source.size());
+}
+
+
+TEST(template_lexer, reports_unterminated_sections) {
+    EXPECT_THROW((void)vole::tokenize_template("text\n  @for x in y"), vole::syntax_exception);
+    EXPECT_THROW((void)vole::tokenize_template("${name"), vole::syntax_exception);
+    EXPECT_THROW((void)vole::tokenize_template("@# comment"), vole::syntax_exception);
+}
+
+
+TEST(template_lexer, simd_matches_scalar_scan) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> letters('a', 'z');
+    std::uniform_int_distribution<int> chance(0, 99);
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1000}) {
+        std::string text(length, ' ');
+        for (auto &c : text) {
+            const auto roll = chance(random);
+            c = roll == 0 ? '@' : roll == 1 ? '$' : static_cast<char>(letters(random));
+        }
+        for (size_t pos = 0; pos <= length; pos++) {
+            ASSERT_EQ(vole::detail::find_marker(text, pos), vole::detail::find_marker_scalar(text, pos))
+                << "length " << length << " pos " << pos;
+        }
+    }
+}
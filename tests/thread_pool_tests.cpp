@@ -0,0 +1,33 @@
+#include <vole/thread_pool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+
+TEST(thread_pool, runs_all_tasks) {
+    std::atomic<size_t> total = 0;
+    std::vector<std::future<size_t>> results;
+    {
+        vole::thread_pool pool(4);
+        EXPECT_EQ(pool.size(), 4);
+        for (size_t i = 0; i < 100; i++) {
+            results.push_back(pool.submit([i, &total] {
+                total += i;
+                return i * 2;
+            }));
+        }
+    }
+    EXPECT_EQ(total, 4950);
+    for (size_t i = 0; i < results.size(); i++) {
+        EXPECT_EQ(results[i].get(), i * 2);
+    }
+}
+
+
+TEST(thread_pool, forwards_exceptions) {
+    vole::thread_pool pool(1);
+    auto result = pool.submit([]() -> int { throw std::runtime_error("failed"); });
+    EXPECT_THROW(result.get(), std::runtime_error);
+}